@@ -1,96 +1,222 @@
 #ifndef ZAIMONI_STL_COW_HPP
 #define ZAIMONI_STL_COW_HPP 1
 
+#include <cassert>
 #include <memory>
+#include <new>
 #include <variant>
 #include <optional>
 
 // copy-on-write -- prioritizing RAM over speed
 namespace zaimoni {
 
+template<class T> struct COW_local {
+	struct type {};
+};
+
+template<class T> requires requires() { typename T::inline_storage; }
+struct COW_local<T> {
+	using type = typename T::inline_storage;
+};
+
+// T may opt into holding small values inline (no heap node, no control block) by declaring a type inline_storage, and
+//   T* inline_copy(void* dest) const;	// placement-copy into dest, or nullptr if this value does not fit
+//   T* inline_move(void* dest) noexcept;	// likewise; only called on values that fit
+// The inline value must be its own T subobject (single inheritance).  An inline value moves with its COW, so its
+// address is not stable; share() and release() promote it to the heap.
 template<class T>
 class COW final {
-	std::shared_ptr<const T> _read; // std::variant here would break operator=
-	std::unique_ptr<T> _write;
+	static constexpr bool has_local = requires() { typename T::inline_storage; };
+
+	enum class mode : unsigned char {
+		none = 0,
+		read,
+		write,
+		local
+	};
+
+	union { // std::variant here would break operator=
+		std::shared_ptr<const T> _read;
+		std::unique_ptr<T> _write;
+		typename COW_local<T>::type _local;
+	};
+	mode _mode = mode::none;
+
+	static inline thread_local size_t _clones = 0;
+	static inline const std::shared_ptr<const T> _null;
 
 public:
-	COW() = default;
+	COW() noexcept {}
 
 	// deleting this constructor is exceptionally painful
-	COW(const COW& src) : _read(src._read) {
-		if (src._write) _write = src._w_clone();
+	COW(const COW& src) {
+		switch (src._mode) {
+		case mode::read:
+			_set(src._read);
+			break;
+		case mode::write:
+		case mode::local:
+			_clone_from(*src.get_c());
+			break;
+		default: break;
+		}
 	}
 
-	COW(COW&& src) = default;
-	COW(const std::shared_ptr<const T>& src) noexcept : _read(src) {}
-	COW(std::unique_ptr<T>&& src)  noexcept : _write(std::move(src)) {}
-	COW(T* src) noexcept : _write(src) {}
-	~COW() = default;
+	COW(COW&& src) noexcept { _take(std::move(src)); }
+	COW(const std::shared_ptr<const T>& src) noexcept { if (src) _set(src); }
+	COW(std::unique_ptr<T>&& src) noexcept { if (src) _set(std::move(src)); }
+	COW(T* src) noexcept { if (src) _set(std::unique_ptr<T>(src)); }
+	// constructs U inline if it fits
+	template<class U, class... Args> explicit COW(std::in_place_type_t<U>, Args&&... args) requires std::is_base_of_v<T, U> {
+		if constexpr (has_local && sizeof(U) <= sizeof(_local) && alignof(U) <= alignof(decltype(_local)) && std::is_nothrow_move_constructible_v<U>) {
+			[[maybe_unused]] T* const dest = ::new(&_local) U(std::forward<Args>(args)...);
+			assert(dest == _local_get());
+			_mode = mode::local;
+		} else _set(std::unique_ptr<T>(new U(std::forward<Args>(args)...)));
+	}
+	~COW() { _reset(); }
 
-	COW(COW& src) : _read(src._read) {
-		if (src._write) {
-			_read = std::shared_ptr<const T>(src._write.release());
-			src = _read;
+	COW(COW& src) {
+		switch (src._mode) {
+		case mode::read:
+			_set(src._read);
+			break;
+		case mode::write:
+			_set(src.share());
+			break;
+		case mode::local:	// cheaper to copy than to share
+			_local_copy(*src._local_get());
+			break;
+		default: break;
 		}
 	}
 
-	COW& operator=(COW&& src) = default;
+	COW& operator=(COW&& src) noexcept {
+		if (this == &src) return *this;
+		if (mode::read == _mode || mode::write == _mode) {	// src may be part of what we own
+			COW stage(std::move(src));
+			_reset();
+			_take(std::move(stage));
+		} else {
+			_reset();
+			_take(std::move(src));
+		}
+		return *this;
+	}
 
 	COW& operator=(const std::shared_ptr<const T>& src) noexcept {
-		_read = src;
-		_write.reset();
+		auto stage(src);
+		_reset();
+		if (stage) _set(std::move(stage));
 		return *this;
 	}
 
 	COW& operator=(std::unique_ptr<T>&& src) noexcept {
-		_write = std::move(src);
-		_read.reset();
+		auto stage(std::move(src));
+		_reset();
+		if (stage) _set(std::move(stage));
 		return *this;
 	}
 
-	COW& operator=(COW& src) noexcept {
+	COW& operator=(COW& src) {
 		if (this == &src) return *this;
-		if (src._read) return *this = src._read;
-		if (!src._write) {
-			_read.reset();
-			_write.reset();
+		switch (src._mode) {
+		case mode::read: return *this = src._read;
+		case mode::write: return *this = src.share();
+		case mode::local: return *this = COW(src);
+		default:
+			_reset();
 			return *this;
 		}
-		_read = std::shared_ptr<const T>(src._write.release());
-		src = _read;
-		return *this;
 	}
 
 	// deleting this operator is exceptionally painful
 	COW& operator=(const COW& src) {
 		if (this == &src) return *this;
-		if (src._write) return *this = src._w_clone();
-		return *this = src._read;
+		return *this = COW(src);
 	}
 
-	explicit operator bool() const { return _read || _write; }
+	explicit operator bool() const { return mode::none != _mode; }
+
+	// deep copies made by this thread, whether to write to a shared value or to copy from a const source
+	static size_t clone_count() { return _clones; }
+
+	bool is_local() const { return mode::local == _mode; }
 
 	const T* get_c() const {
-		if (_read) return _read.get();
-		if (_write) return _write.get();
-		return nullptr;
+		switch (_mode) {
+		case mode::read: return _read.get();
+		case mode::write: return _write.get();
+		case mode::local: return _local_get();
+		default: return nullptr;
+		}
 	}
 
 	const T* get() const { return get_c(); }
 
 	T* get() { // multi-threaded: race condition against operoator=(COW& src)
-		if (_read) _rw_clone();
-		if (_write) return _write.get();
-		return nullptr;
+		if (mode::read == _mode) _rw_clone();
+		switch (_mode) {
+		case mode::write: return _write.get();
+		case mode::local: return _local_get();
+		default: return nullptr;
+		}
 	}
 
 	const T* operator->() const { return get_c(); }
 	T* operator->() { return get(); }
 
 	T* release() {
-		if (_read) _rw_clone();
-		if (_write) return _write.release();
-		return nullptr;
+		if (mode::read == _mode) _rw_clone();
+		switch (_mode) {
+		case mode::write: {
+			T* const ret = _write.release();
+			_reset();
+			return ret;
+			}
+		case mode::local: {
+			T* const ret = _local_get()->clone();
+			_reset();
+			return ret;
+			}
+		default: return nullptr;
+		}
+	}
+
+	// converts to the read-only representation; the returned pointer is shared with us
+	const std::shared_ptr<const T>& share() {
+		switch (_mode) {
+		case mode::write: {
+			std::shared_ptr<const T> stage(_write.release());
+			_reset();
+			_set(std::move(stage));
+			}
+			break;
+		case mode::local: {
+			std::shared_ptr<const T> stage(_local_get()->clone());
+			_reset();
+			_set(std::move(stage));
+			}
+			break;
+		case mode::none: return _null;
+		default: break;
+		}
+		return _read;
+	}
+
+	// moves a value only we hold into inline storage, if it fits.  Pointers to the value are invalidated.
+	bool localize() noexcept {
+		if constexpr (has_local) {
+			if (mode::write != _mode) return false;
+			auto stage(std::move(_write));
+			_reset();
+			if (stage->inline_move(&_local)) {
+				_mode = mode::local;
+				return true;
+			}
+			_set(std::move(stage));
+		}
+		return false;
 	}
 
 	/// <returns>std::nullopt, or .second is non-null and .first is non-null if non-const operations are not logic errors</returns>
@@ -115,38 +241,101 @@ public:
 	// value equality of contents
 	friend bool operator==(const COW& lhs, const COW& rhs) {
 		if (&lhs == &rhs) return true;
-		if (lhs._read) {
-			if (rhs._read) {
-				return 0 == *lhs._read <=> *rhs._read;
-			} else if (rhs._write) {
-				return 0 == *lhs._read <=> *rhs._write;
-			} else return false;
-		} else if (lhs._write) {
-			if (rhs._read) {
-				return 0 == *lhs._write <=> *rhs._read;
-			} else if (rhs._write) {
-				return 0 == *lhs._write <=> *rhs._write;
-			} else return false;
-		} else return !rhs._read && !rhs._write;
+		const auto l = lhs.get_c();
+		const auto r = rhs.get_c();
+		if (l && r) return 0 == *l <=> *r;
+		return !l && !r;
 	}
 
 private:
-	auto _w_clone() const requires requires() { _write->clone(); } {
-		return std::unique_ptr<T>(_write->clone());
+	T* _local_get() const { return std::launder(reinterpret_cast<T*>(const_cast<decltype(_local)*>(&_local))); }
+
+	// only when we hold nothing
+	void _set(const std::shared_ptr<const T>& src) noexcept {
+		::new(&_read) std::shared_ptr<const T>(src);
+		_mode = mode::read;
+	}
+
+	void _set(std::shared_ptr<const T>&& src) noexcept {
+		::new(&_read) std::shared_ptr<const T>(std::move(src));
+		_mode = mode::read;
+	}
+
+	void _set(std::unique_ptr<T>&& src) noexcept {
+		::new(&_write) std::unique_ptr<T>(std::move(src));
+		_mode = mode::write;
+	}
+
+	bool _local_copy(const T& src) {
+		if constexpr (has_local) {
+			if (auto dest = src.inline_copy(&_local)) {
+				assert(dest == _local_get());
+				_mode = mode::local;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void _take(COW&& src) noexcept {
+		switch (src._mode) {
+		case mode::read:
+			_set(std::move(src._read));
+			break;
+		case mode::write:
+			_set(std::move(src._write));
+			break;
+		case mode::local:
+			if constexpr (has_local) {
+				src._local_get()->inline_move(&_local);
+				_mode = mode::local;
+			}
+			break;
+		default: return;
+		}
+		src._reset();
+	}
+
+	void _reset() noexcept {
+		switch (_mode) {
+		case mode::read:
+			_read.~shared_ptr();
+			break;
+		case mode::write:
+			_write.~unique_ptr();
+			break;
+		case mode::local:
+			_local_get()->~T();
+			break;
+		default: break;
+		}
+		_mode = mode::none;
+	}
+
+	void _clone_from(const T& src) requires requires() { src.clone(); } {
+		++_clones;
+		if (!_local_copy(src)) _set(std::unique_ptr<T>(src.clone()));
 	}
 
 	void _rw_clone() requires requires() { _read->clone(); } {
-		_write = std::unique_ptr<T>(_read->clone());
-		_read.reset();
+		const auto src(std::move(_read));
+		_reset();
+		_clone_from(*src);
 	}
 
 	template<class U> std::optional<std::variant<U*, const U*> > _get_rw() {
-		if (_read) {
+		switch (_mode) {
+		case mode::read:
 			if (auto test = dynamic_cast<const U*>(_read.get())) return test;
-		};
-		if (_write) {
+			break;
+		case mode::write:
 			if (auto test = dynamic_cast<U*>(_write.get())) return test;
-		};
+			break;
+		case mode::local:
+			if (auto test = dynamic_cast<U*>(_local_get())) return test;
+			break;
+		default: break;
+		}
 		return std::nullopt;
 	}
 };
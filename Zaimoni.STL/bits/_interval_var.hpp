@@ -60,6 +60,10 @@ namespace detail {
 	};
 
 }
+
+	template<std::floating_point T>
+	struct fp_leaf_tag<ISK_INTERVAL<T> > : public std::integral_constant<fp_leaf, fp_leaf(8 | (unsigned char)fp_leaf_tag<T>::value)> {};
+
 }
 
 #endif
@@ -2,14 +2,18 @@
 #define EVAL_HPP 1
 
 #include <limits.h>
+#include <array>
+#include <cstdint>
 #include <limits>
 #include <utility>
 #include <string>
 #include <compare>
 #include <stdexcept>
+#include <typeinfo>
 #include "augment.STL/type_traits"
 #include "zero.hpp"
 #include "COW.hpp"
+#include "pool.hpp"
 
 namespace zaimoni {
 
@@ -41,11 +45,108 @@ namespace zaimoni {
 	// while we want to support vector spaces, matrices, etc., that looks it like it requires more general methods than an operation enum
 	// e.g., consider a 2-dimensional vector space of operations on the surface of a 3-dimesnional sphere
 	namespace math {
+		// the subclass relation of the _type<> hierarchy below, and what it implies for type::defined, as bit tables
+		// indexed by arch_domain.  O(1) alternative to the virtual calls and dynamic_casts; must agree with them.
+		class domain_lattice final {
+		public:
+			static constexpr size_t size = _type_spec::_S1_ + 1;
+			using row = uint16_t;	// bit n: domain n
+			static_assert(std::numeric_limits<row>::digits >= size);
+
+		private:
+			// each domain's immediate superclasses, as declared by the _type<> specializations
+			static constexpr row _parents(int src) {
+				switch (src) {
+				case _type_spec::_Z_: return row(1) << _type_spec::_Q_;
+				case _type_spec::_Q_: return row(1) << _type_spec::_R_;
+				case _type_spec::_R_: return (row(1) << _type_spec::_C_) | (row(1) << _type_spec::_R_SHARP_);
+				case _type_spec::_C_: return (row(1) << _type_spec::_H_) | (row(1) << _type_spec::_C_SHARP_);
+				case _type_spec::_H_: return (row(1) << _type_spec::_O_) | (row(1) << _type_spec::_H_SHARP_);
+				case _type_spec::_O_: return row(1) << _type_spec::_O_SHARP_;
+				default: return 0;
+				}
+			}
+
+			// reflexive, transitive closure of _parents
+			static constexpr std::array<row, size> _superclasses() {
+				std::array<row, size> ret = {};
+				for (size_t i = 1; i < size; ++i) ret[i] = (row(1) << i) | _parents(i);
+				bool changed;
+				do {
+					changed = false;
+					for (size_t i = 1; i < size; ++i) {
+						row stage = ret[i];
+						for (size_t j = 1; j < size; ++j) if (ret[i] & (row(1) << j)) stage |= ret[j];
+						if (stage != ret[i]) {
+							ret[i] = stage;
+							changed = true;
+						}
+					}
+				} while (changed);
+				return ret;
+			}
+
+			static const std::array<row, size> _superclass_of;
+
+			// bit n of [op-1][lhs] or [op-1][rhs]: the defaults of type::left/type::right accept domain n.  _S1_ overrides them.
+			static constexpr std::array<std::array<row, size>, 2> _accepts() {
+				std::array<std::array<row, size>, 2> ret = {};
+				for (size_t i = 1; i < size; ++i) {
+					for (size_t j = 1; j < size; ++j) {
+						if (_superclass_of[j] & (row(1) << i)) ret[0][i] |= row(1) << j;
+					}
+					ret[1][i] = ret[0][i];
+				}
+				row reals = 0;
+				for (size_t j = 1; j < size; ++j) if (_superclass_of[j] & (row(1) << _type_spec::_R_SHARP_)) reals |= row(1) << j;
+				ret[_type_spec::Multiplication - 1][_type_spec::_S1_] = reals;
+				return ret;
+			}
+
+			static const std::array<std::array<row, size>, 2> _accepted_by;
+
+		public:
+			// 0: not a built-in domain
+			static constexpr bool is_subclass(int lhs, int rhs) { return _superclass_of[lhs] & (row(1) << rhs); }	// non-strict
+			static constexpr std::partial_ordering subclass(int lhs, int rhs) {
+				if (lhs == rhs) return std::partial_ordering::equivalent;
+				if (is_subclass(lhs, rhs)) return std::partial_ordering::less;
+				if (is_subclass(rhs, lhs)) return std::partial_ordering::greater;
+				return std::partial_ordering::unordered;
+			}
+			// 0: not defined; -1: lhs; 1: rhs
+			static constexpr int defined(int lhs, _type_spec::canonical_functions op, int rhs) {
+				const auto& accepts = _accepted_by[op - 1];
+				if (accepts[lhs] & (row(1) << rhs)) return -1;
+				if (accepts[rhs] & (row(1) << lhs)) return 1;
+				return 0;
+			}
+		};
+
+		inline constexpr std::array<domain_lattice::row, domain_lattice::size> domain_lattice::_superclass_of = domain_lattice::_superclasses();
+		inline constexpr std::array<std::array<domain_lattice::row, domain_lattice::size>, 2> domain_lattice::_accepted_by = domain_lattice::_accepts();
+
+		static_assert(domain_lattice::is_subclass(_type_spec::_Z_, _type_spec::_O_SHARP_));
+		static_assert(!domain_lattice::is_subclass(_type_spec::_R_SHARP_, _type_spec::_C_SHARP_));
+		static_assert(std::partial_ordering::unordered == domain_lattice::subclass(_type_spec::_S1_, _type_spec::_R_));
+		static_assert(1 == domain_lattice::defined(_type_spec::_Z_, _type_spec::Addition, _type_spec::_C_));
+		static_assert(-1 == domain_lattice::defined(_type_spec::_S1_, _type_spec::Multiplication, _type_spec::_Q_));
+		static_assert(0 == domain_lattice::defined(_type_spec::_S1_, _type_spec::Addition, _type_spec::_R_));
+
 		struct type {
+		private:
+			const unsigned char _arch;	// arch_domain of a built-in domain; else 0
+
+		public:
+			type() noexcept : _arch(0) {}
+			explicit type(_type_spec::arch_domain src) noexcept : _arch(src) {}	// for the _type<> specializations only
 			virtual ~type() = default;
 			virtual int allow_infinity() const = 0;	// 0: no; -1: signed; 1 unsigned
 			virtual bool is_totally_ordered() const = 0;
-			std::partial_ordering subclass(const type& rhs) const { return rhs._superclass(this); }
+			std::partial_ordering subclass(const type& rhs) const {
+				if (_arch && rhs._arch) return domain_lattice::subclass(_arch, rhs._arch);
+				return rhs._superclass(this);
+			}
 			// evaluate type of canonical operations (generally binary functions)
 			virtual const type* self(_type_spec::canonical_functions op) const = 0;
 			type* self(_type_spec::canonical_functions op) { return const_cast<type*>(const_cast<const type*>(this)->self(op)); }
@@ -68,15 +169,18 @@ namespace zaimoni {
 			type* inverse(_type_spec::canonical_functions op) { return const_cast<type*>(const_cast<const type*>(this)->inverse(op)); }
 
 			static const type* defined(const type& lhs, _type_spec::canonical_functions op, const type& rhs) {
+				if (lhs._arch && rhs._arch) {
+					switch (domain_lattice::defined(lhs._arch, op, rhs._arch)) {
+					case -1: return &lhs;
+					case 1: return &rhs;
+					default: return nullptr;
+					}
+				}
 				if (auto test = lhs.left(op, rhs)) return test;
 				if (auto test = rhs.right(op, lhs)) return test;
 				return nullptr;
 			}
-			static type* defined(type& lhs, _type_spec::canonical_functions op, type& rhs) {
-				if (auto test = lhs.left(op, rhs)) return test;
-				if (auto test = rhs.right(op, lhs)) return test;
-				return nullptr;
-			}
+			static type* defined(type& lhs, _type_spec::canonical_functions op, type& rhs) { return const_cast<type*>(defined(const_cast<const type&>(lhs), op, const_cast<const type&>(rhs))); }
 
 		private:
 			virtual std::partial_ordering _superclass(const type* rhs) const {
@@ -146,11 +250,35 @@ namespace zaimoni {
 		virtual T* eval_dividedby(const typename eval_to_ptr<T>::eval_type& rhs) const = 0;
 	};
 
+	// compact run-time type tags for the numeral leaves; O(1) alternative to a dynamic_cast cascade
+	enum class fp_leaf : unsigned char {
+		none = 0,
+		f,
+		d,
+		ld,
+		s_int,
+		u_int,
+		interval_f = 9,	// interval flag is 8
+		interval_d,
+		interval_ld
+	};
+
+	constexpr bool is_interval(fp_leaf src) { return static_cast<unsigned char>(src) & 8; }
+
+	template<class T> struct fp_leaf_tag : public std::integral_constant<fp_leaf, fp_leaf::none> {};
+
+	// boost::hash_combine
+	constexpr size_t hash_combine(size_t seed, size_t src) { return seed ^ (src + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+
 	struct fp_API {	// virtual base
 		static constexpr std::pair<intmax_t, intmax_t> max_scal_bn_safe_range() { return std::pair<intmax_t, intmax_t>(std::numeric_limits<intmax_t>::min(), std::numeric_limits<intmax_t>::max()); }	// simple static member variable crashes at link-time even if initialized here
 
 		virtual ~fp_API() = default;
 
+		// expression nodes are small and short-lived; see node_pool::scope
+		static void* operator new(size_t n) { return node_pool::allocate(n); }
+		static void operator delete(void* src) noexcept { node_pool::deallocate(src); }
+
 		/// <summary>
 		/// Run-time mathematical type system.  Reference return interferes with n-ary operation domain estimation
 		/// </summary>
@@ -158,6 +286,7 @@ namespace zaimoni {
 		virtual const math::type* domain() const = 0; // for Kuroda grammar approach
 
 		virtual bool self_eval() = 0;
+		virtual std::optional<bool> local_self_eval() { return std::nullopt; }	// self_eval, leaving the terms alone; nullopt if self_eval already does
 
 		static bool algebraic_reduce(eval_to_ptr<fp_API>::eval_type& dest) {
 			if (auto efficient = dest.get_rw<eval_to_ptr<fp_API> >()) {
@@ -185,11 +314,7 @@ namespace zaimoni {
 					if (efficient->first->self_eval()) return true;
 				}
 			}
-			if (auto result = dest->_eval()) {
-				dest = std::unique_ptr<fp_API>(result);
-				return true;
-			}
-			return false;
+			return _eval_reduce(dest);
 		}
 
 		static bool eval(eval_to_ptr<fp_API>::eval_type& dest) {
@@ -199,6 +324,16 @@ namespace zaimoni {
 			return false;
 		}
 
+		// eval for this node alone: its terms are taken to be at a fixed point already (see fp_rewriter)
+		static bool local_eval(eval_to_ptr<fp_API>::eval_type& dest) {
+			if (algebraic_reduce(dest)) return true;
+			if (auto efficient = dest.get_rw<fp_API>()) {
+				if (!efficient->first) efficient->first = dest.get();
+				if (const auto local = efficient->first->local_self_eval()) return *local || _eval_reduce(dest);
+			}
+			return inexact_reduce(dest);
+		}
+
 		// numerical support -- these have coordinate-wise definitions available
 		// we do not propagate NaN so no test here for it
 		virtual bool is_inf() const {
@@ -232,6 +367,36 @@ namespace zaimoni {
 		virtual std::string to_s() const = 0;
 		virtual int precedence() const = 0;
 		virtual int precedence_to_s() const { return precedence(); }
+		virtual fp_leaf leaf_tag() const { return fp_leaf::none; }	// non-none only for var_fp
+		// small-value storage for COW<fp_API>: numeral leaves that fit placement-construct themselves at dest; the rest
+		// return nullptr and stay on the heap
+		struct alignas(void*) inline_storage { unsigned char _x[3 * sizeof(void*)]; };
+		virtual fp_API* inline_copy(void*) const { return nullptr; }
+		virtual fp_API* inline_move(void*) noexcept { return nullptr; }
+
+		// structural (syntactic) access.  Terms are the immediate sub-expressions.
+		// term() is for value-preserving replacement (e.g. hash-consing); it does not reset evaluation heuristics
+		virtual size_t arity() const { return 0; }
+		virtual const COW<fp_API>* term_c(size_t) const { return nullptr; }
+		virtual COW<fp_API>* term(size_t) { return nullptr; }
+		// these two do not recurse into terms
+		virtual size_t node_hash() const { return 0; }
+		virtual bool node_equal(const fp_API&) const { return true; } // only called when typeid matches
+
+		virtual size_t structural_hash() const { return _structural_hash(); }	// nodes that cache it override this
+
+		bool structural_equal(const fp_API& rhs) const {
+			if (this == &rhs) return true;
+			if (typeid(*this) != typeid(rhs)) return false;
+			const size_t ub = arity();
+			if (ub != rhs.arity() || !node_equal(rhs)) return false;
+			for (size_t i = 0; i < ub; ++i) {
+				const auto l = term_c(i)->get_c();
+				const auto r = rhs.term_c(i)->get_c();
+				if (l != r && !l->structural_equal(*r)) return false;
+			}
+			return true;
+		}
 
 		std::partial_ordering value_compare(const fp_API* rhs) const {
 			if (!rhs) return std::partial_ordering::unordered; // might need this to "work"
@@ -242,8 +407,23 @@ namespace zaimoni {
 
 	protected:
 		bool is_scal_bn_identity_default() const { return is_zero() || is_inf(); }
+		size_t _structural_hash() const {
+			size_t ret = hash_combine(typeid(*this).hash_code(), node_hash());
+			const size_t ub = arity();
+			for (size_t i = 0; i < ub; ++i) ret = hash_combine(ret, term_c(i)->get_c()->structural_hash());
+			return ret;
+		}
 
 	private:
+		static bool _eval_reduce(eval_to_ptr<fp_API>::eval_type& dest) {
+			if (auto result = dest->_eval()) {
+				dest = std::unique_ptr<fp_API>(result);
+				dest.localize();
+				return true;
+			}
+			return false;
+		}
+
 		virtual void _scal_bn(intmax_t scale) = 0;	// power-of-two
 		virtual fp_API* _eval() const = 0;	// memory-allocating evaluation
 		virtual std::optional<bool> _is_finite() const { throw std::logic_error("must define _is_finite"); }
@@ -277,6 +457,7 @@ namespace zaimoni {
 	template<>
 	struct _type<_type_spec::_O_SHARP_> : public virtual math::type {
 		enum { _allow_infinity = 1 };
+		_type() noexcept : type(_type_spec::_O_SHARP_) {}
 
 		int allow_infinity() const override { return _allow_infinity; }
 		bool is_totally_ordered() const override { return false; }
@@ -295,6 +476,7 @@ namespace zaimoni {
 	template<>
 	struct _type<_type_spec::_H_SHARP_> : public virtual math::type {
 		enum { _allow_infinity = 1 };
+		_type() noexcept : type(_type_spec::_H_SHARP_) {}
 
 		int allow_infinity() const override { return _allow_infinity; }
 		bool is_totally_ordered() const override { return false; }
@@ -313,6 +495,7 @@ namespace zaimoni {
 	template<>
 	struct _type<_type_spec::_C_SHARP_> : public virtual math::type {
 		enum { _allow_infinity = 1 };
+		_type() noexcept : type(_type_spec::_C_SHARP_) {}
 
 		int allow_infinity() const override { return _allow_infinity; }
 		bool is_totally_ordered() const override { return false; }
@@ -331,6 +514,7 @@ namespace zaimoni {
 	template<>
 	struct _type<_type_spec::_R_SHARP_> : public virtual math::type {
 		enum { _allow_infinity = -1 };
+		_type() noexcept : type(_type_spec::_R_SHARP_) {}
 
 		int allow_infinity() const override { return _allow_infinity; }
 		bool is_totally_ordered() const override { return true; }
@@ -350,6 +534,7 @@ namespace zaimoni {
 	template<>
 	struct _type<_type_spec::_S1_> final : public virtual math::type {
 		enum { _allow_infinity = 0 };
+		_type() noexcept : type(_type_spec::_S1_) {}
 
 		int allow_infinity() const override { return _allow_infinity; }
 		bool is_totally_ordered() const override { return false; }
@@ -376,7 +561,7 @@ namespace zaimoni {
 		}
 
 	private:
-		std::partial_ordering _superclass(const type* rhs) const override { return _nonstrictSuperclass(this) ? std::partial_ordering::equivalent : std::partial_ordering::unordered; }
+		std::partial_ordering _superclass(const type* rhs) const override { return _nonstrictSuperclass(rhs) ? std::partial_ordering::equivalent : std::partial_ordering::unordered; }
 		bool _nonstrictSuperclass(const type* rhs) const override { return nullptr != dynamic_cast<decltype(this)>(rhs); }
 	};
 	static_assert(0 == _type<_type_spec::_S1_>::_allow_infinity);
@@ -386,6 +571,7 @@ namespace zaimoni {
 	struct _type<_type_spec::_O_> : public _type<_type_spec::_O_SHARP_> {
 		enum { _allow_infinity = 0 };
 
+		_type() noexcept : type(_type_spec::_O_) {}
 		virtual ~_type() = default;
 
 		// numerical support -- these have coordinate-wise definitions available
@@ -406,6 +592,7 @@ namespace zaimoni {
 	struct _type<_type_spec::_H_> : public _type<_type_spec::_O_>, public _type<_type_spec::_H_SHARP_> {
 		enum { _allow_infinity = 0 };
 
+		_type() noexcept : type(_type_spec::_H_) {}
 		virtual ~_type() = default;
 
 		// numerical support -- these have coordinate-wise definitions available
@@ -427,6 +614,7 @@ namespace zaimoni {
 	struct _type<_type_spec::_C_> : public _type<_type_spec::_H_>, public _type<_type_spec::_C_SHARP_> {
 		enum { _allow_infinity = 0 };
 
+		_type() noexcept : type(_type_spec::_C_) {}
 		virtual ~_type() = default;
 
 		// numerical support -- these have coordinate-wise definitions available
@@ -447,6 +635,7 @@ namespace zaimoni {
 	template<>
 	struct _type<_type_spec::_R_> : public _type<_type_spec::_C_>, public _type<_type_spec::_R_SHARP_> {
 		enum { _allow_infinity = 0 };
+		_type() noexcept : type(_type_spec::_R_) {}
 
 		int allow_infinity() const override { return _allow_infinity; }
 		bool is_totally_ordered() const override { return true; }
@@ -464,6 +653,8 @@ namespace zaimoni {
 
 	template<>
 	struct _type<_type_spec::_Q_> : public _type<_type_spec::_R_> {
+		_type() noexcept : type(_type_spec::_Q_) {}
+
 		const type* self(_type_spec::canonical_functions op) const override {
 			switch (op) {
 			case _type_spec::Addition:
@@ -478,6 +669,8 @@ namespace zaimoni {
 
 	template<>
 	struct _type<_type_spec::_Z_> final : public _type<_type_spec::_Q_> {
+		_type() noexcept : type(_type_spec::_Z_) {}
+
 		const type* self(_type_spec::canonical_functions op) const override {
 			switch (op) {
 			case _type_spec::Addition:
@@ -141,8 +141,8 @@ public:
 		case 1: lhs = std::move(rhs);	// intentional fall-through
 		case -1: return true;
 		case -2:	// not using partial rearrangement here
+		case 0:	// may still have swapped lhs and rhs
 			lhs = revert;
-		case 0:
 			return false;
 		default: _fatal_code("trivial::sum: rearrange<T>::sum code out of range", 3);
 		}
@@ -338,7 +338,7 @@ interval<T> interval<T>::hull(const T& x, const T& y)
 
 template<class T> interval<T> square(const interval<T>& x) {
 	if (0 != sgn(x) || is_zero(x.lower()) || is_zero(x.upper())) return x * x;
-	const bool favor_ub = x.upper() >= x.lower();
+	const bool favor_ub = x.upper() >= -x.lower();
 	interval<T> tmp(favor_ub ? T(0) : x.lower(), favor_ub ? x.upper() : -T(0));
 	return tmp * tmp;
 }
@@ -655,7 +655,7 @@ interval<T>& interval<T>::operator*=(const interval<T>& rhs)
 		bits::round_set<T>(FE_UPWARD);
 		const T ub_1(_lb*rhs._lb);
 		const T ub_2(_ub*rhs._ub);
-		assign((lb_1 < lb_2 ? lb_1 : lb_2), (ub_1 < ub_2 ? ub_1 : ub_2));
+		assign((lb_1 < lb_2 ? lb_1 : lb_2), (ub_1 < ub_2 ? ub_2 : ub_1));
 		return *this;
 	}
 	_fatal_code("*= : unhandled", 3);
@@ -0,0 +1,175 @@
+#ifndef ZAIMONI_STL_POOL_HPP
+#define ZAIMONI_STL_POOL_HPP 1
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace zaimoni {
+
+struct node_pool_stats {
+	size_t pool_allocs = 0;
+	size_t pool_frees = 0;
+	size_t heap_allocs = 0;	// no scope active, or too large to pool
+	size_t heap_frees = 0;
+	size_t chunk_allocs = 0;	// what the pooled allocations cost the global heap
+	size_t chunk_frees = 0;
+};
+
+// size-class pooled allocation for small polymorphic nodes.  While a node_pool::scope is alive on this thread,
+// allocations come from that scope's arena; the arena releases all of its chunks at once, when the scope has ended
+// and the last block from it has been deleted.  Blocks may outlive their scope.
+// Scopes and statistics are per thread.  A block may be deleted on any thread; blocks deleted away from their arena's
+// thread are handed back to it through a lock-free list.
+class node_pool final {
+public:
+	using stats = node_pool_stats;
+
+	static constexpr size_t granularity = alignof(std::max_align_t);
+	static constexpr size_t size_classes = 16;	// largest pooled block, including header, is granularity*size_classes
+	static constexpr size_t chunk_size = 64 * 1024;
+
+private:
+	struct arena;
+
+	struct alignas(std::max_align_t) header {
+		arena* owner;	// nullptr: global heap
+		size_t size_class;
+	};
+
+	struct free_block {
+		free_block* next;
+		size_t size_class;	// overlays header::size_class
+	};
+
+	struct arena {
+		arena* const parent;	// enclosing scope
+		const std::thread::id thread;
+		std::vector<void*> chunks;
+		free_block* free_list[size_classes] = {};
+		std::atomic<free_block*> remote = nullptr;	// deleted by other threads; any size class
+		char* bump = nullptr;
+		char* bump_end = nullptr;
+		std::atomic<size_t> live = 1;	// blocks, plus one for the scope
+
+		explicit arena(arena* up) : parent(up), thread(std::this_thread::get_id()) {}
+		arena(const arena& src) = delete;
+		arena(arena&& src) = delete;
+		~arena() {
+			for (auto x : chunks) ::operator delete(x);
+			_stats.chunk_frees += chunks.size();
+		}
+		arena& operator=(const arena& src) = delete;
+		arena& operator=(arena&& src) = delete;
+
+		void* allocate(size_t sc) {
+			live.fetch_add(1, std::memory_order_relaxed);
+			if (!free_list[sc] && remote.load(std::memory_order_relaxed)) {
+				auto x = remote.exchange(nullptr, std::memory_order_acquire);
+				while (x) {
+					const auto next = x->next;
+					x->next = free_list[x->size_class];
+					free_list[x->size_class] = x;
+					x = next;
+				}
+			}
+			if (auto x = free_list[sc]) {
+				free_list[sc] = x->next;
+				return x;
+			}
+			const size_t n = (sc + 1) * granularity;
+			if (bump_end - bump < (ptrdiff_t)n) {
+				chunks.push_back(bump = static_cast<char*>(::operator new(chunk_size)));
+				bump_end = bump + chunk_size;
+				++_stats.chunk_allocs;
+			}
+			auto ret = bump;
+			bump += n;
+			return ret;
+		}
+
+		// returns true when the arena is now garbage
+		bool deallocate(void* src, size_t sc) {
+			auto x = static_cast<free_block*>(src);
+			if (std::this_thread::get_id() == thread) {
+				x->next = free_list[sc];
+				free_list[sc] = x;
+			} else {
+				x->next = remote.load(std::memory_order_relaxed);
+				while (!remote.compare_exchange_weak(x->next, x, std::memory_order_release, std::memory_order_relaxed));
+			}
+			return release();
+		}
+
+		bool release() { return 1 == live.fetch_sub(1, std::memory_order_acq_rel); }
+	};
+
+	static inline thread_local arena* _current = nullptr;
+	static inline thread_local stats _stats;
+
+public:
+	class scope final {
+		arena* const _arena;
+	public:
+		scope() : _arena(new arena(_current)) { _current = _arena; }
+		scope(const scope& src) = delete;
+		scope(scope&& src) = delete;
+		~scope() {
+			_current = _arena->parent;
+			if (_arena->release()) delete _arena;
+		}
+		scope& operator=(const scope& src) = delete;
+		scope& operator=(scope&& src) = delete;
+	};
+
+	// suspends this thread's scopes: allocations go to the global heap, e.g. for caches that must not keep an arena alive
+	class heap_scope final {
+		arena* const _suspended;
+	public:
+		heap_scope() noexcept : _suspended(_current) { _current = nullptr; }
+		heap_scope(const heap_scope& src) = delete;
+		heap_scope(heap_scope&& src) = delete;
+		~heap_scope() { _current = _suspended; }
+		heap_scope& operator=(const heap_scope& src) = delete;
+		heap_scope& operator=(heap_scope&& src) = delete;
+	};
+
+	node_pool() = delete;
+
+	static void* allocate(size_t n) {
+		const size_t sc = (sizeof(header) + n - 1) / granularity;
+		header* ret;
+		if (_current && size_classes > sc) {
+			ret = static_cast<header*>(_current->allocate(sc));
+			ret->owner = _current;
+			++_stats.pool_allocs;
+		} else {
+			ret = static_cast<header*>(::operator new(sizeof(header) + n));
+			ret->owner = nullptr;
+			++_stats.heap_allocs;
+		}
+		ret->size_class = sc;
+		return ret + 1;
+	}
+
+	static void deallocate(void* src) noexcept {
+		if (!src) return;
+		auto h = static_cast<header*>(src) - 1;
+		if (auto x = h->owner) {
+			++_stats.pool_frees;
+			if (x->deallocate(h, h->size_class)) delete x;
+		} else {
+			++_stats.heap_frees;
+			::operator delete(h);
+		}
+	}
+
+	static const stats& statistics() { return _stats; }	// this thread's
+	static void reset_statistics() { _stats = stats(); }
+};
+
+}	// namespace zaimoni
+
+#endif
@@ -7,10 +7,26 @@
 #include "augment.STL/cmath"
 #include "numeric_error.hpp"
 #include <charconv>
+#include <functional>
 #include <type_traits>
 
 namespace zaimoni::detail {
 
+	// structural identity of values: for floating-point, -0.0 is not 0.0 and a NaN is itself (payloads aside)
+	template<class T> bool identical(const T& lhs, const T& rhs) {
+		if constexpr (std::is_floating_point_v<T>) {
+			if (std::isnan(lhs)) return std::isnan(rhs) && std::signbit(lhs) == std::signbit(rhs);
+			return lhs == rhs && std::signbit(lhs) == std::signbit(rhs);
+		} else return lhs == rhs;
+	}
+
+	template<class T> size_t identity_hash(const T& x) {
+		if constexpr (std::is_floating_point_v<T>) {
+			if (std::isnan(x)) return std::signbit(x) ? 2 : 1;
+			return hash_combine(std::hash<T>()(x), std::signbit(x));
+		} else return std::hash<T>()(x);
+	}
+
 	template<class T>
 	struct var_fp_impl
 	{
@@ -68,6 +84,12 @@ namespace zaimoni::detail {
 
 namespace zaimoni {
 
+	template<> struct fp_leaf_tag<float> : public std::integral_constant<fp_leaf, fp_leaf::f> {};
+	template<> struct fp_leaf_tag<double> : public std::integral_constant<fp_leaf, fp_leaf::d> {};
+	template<> struct fp_leaf_tag<long double> : public std::integral_constant<fp_leaf, fp_leaf::ld> {};
+	template<> struct fp_leaf_tag<intmax_t> : public std::integral_constant<fp_leaf, fp_leaf::s_int> {};
+	template<> struct fp_leaf_tag<uintmax_t> : public std::integral_constant<fp_leaf, fp_leaf::u_int> {};
+
 	template<class T>
 	class var_fp final : public fp_API // "variable, floating-point" (actually value as we aren't tracking display name)
 	{
@@ -108,8 +130,35 @@ namespace zaimoni {
 
 		std::string to_s() const override { return detail::var_fp_impl<T>::to_s(_x); }
 		int precedence() const override { return std::numeric_limits<int>::max(); }	// things like numerals generally outrank all operators
+		fp_leaf leaf_tag() const override { return fp_leaf_tag<T>::value; }
+		fp_API* inline_copy(void* dest) const override {
+			if constexpr (fits_inline()) return ::new(dest) var_fp(*this);
+			else return nullptr;
+		}
+		fp_API* inline_move(void* dest) noexcept override {
+			if constexpr (fits_inline()) return ::new(dest) var_fp(std::move(*this));
+			else return nullptr;
+		}
+
+		size_t node_hash() const override {
+			if constexpr (requires { _x.lower(); _x.upper(); }) {
+				return hash_combine(detail::identity_hash(_x.lower()), detail::identity_hash(_x.upper()));
+			} else if constexpr (requires { std::hash<T>()(_x); }) {
+				return detail::identity_hash(_x);
+			} else return 0;
+		}
+		bool node_equal(const fp_API& rhs) const override {
+			const auto& r = static_cast<const var_fp&>(rhs);
+			// interval operator== is not structural equality
+			if constexpr (requires { _x.lower(); _x.upper(); }) return detail::identical(_x.lower(), r._x.lower()) && detail::identical(_x.upper(), r._x.upper());
+			else return detail::identical(_x, r._x);
+		}
 
 	private:
+		static constexpr bool fits_inline() {
+			return sizeof(var_fp) <= sizeof(inline_storage) && alignof(var_fp) <= alignof(inline_storage) && std::is_nothrow_move_constructible_v<T>;
+		}
+
 		void _scal_bn(intmax_t scale) override { return detail::var_fp_impl<T>::_scal_bn(_x, scale); }	// power-of-two
 		fp_API* _eval() const override { return detail::var_fp_impl<T>::_eval(_x); }	// memory-allocating evaluation
 		std::partial_ordering _value_compare(const fp_API* rhs) const override {
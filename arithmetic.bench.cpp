@@ -0,0 +1,77 @@
+// microbenchmark: numeral leaf classification, dynamic_cast cascade vs. fp_API::leaf_tag
+#include "arithmetic.hpp"
+#include "sum.hpp"
+#include "Zaimoni.STL/var.hpp"
+#include "Zaimoni.STL/interval.hpp"
+#include "Zaimoni.STL/Logging.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+using zaimoni::var_fp;
+using zaimoni::fp_API;
+using zaimoni::fp_leaf;
+
+// the pre-tag dispatch path of zaimoni::math::parse_for::const_primitive
+static int by_cascade(const fp_API* src)
+{
+	if (dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(src)) return 1;
+	if (dynamic_cast<const var_fp<float>*>(src)) return 2;
+	if (dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(src)) return 3;
+	if (dynamic_cast<const var_fp<double>*>(src)) return 4;
+	if (dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(src)) return 5;
+	if (dynamic_cast<const var_fp<long double>*>(src)) return 6;
+	if (dynamic_cast<const var_fp<intmax_t>*>(src)) return 7;
+	if (dynamic_cast<const var_fp<uintmax_t>*>(src)) return 8;
+	return 0;
+}
+
+static int by_tag(const fp_API* src)
+{
+	switch (src->leaf_tag()) {
+	case fp_leaf::interval_f: return 1;
+	case fp_leaf::f: return 2;
+	case fp_leaf::interval_d: return 3;
+	case fp_leaf::d: return 4;
+	case fp_leaf::interval_ld: return 5;
+	case fp_leaf::ld: return 6;
+	case fp_leaf::s_int: return 7;
+	case fp_leaf::u_int: return 8;
+	default: return 0;
+	}
+}
+
+template<class F>
+static void time_it(const char* label, F classify, const std::vector<zaimoni::eval_to_ptr<fp_API>::eval_type>& src, size_t reps)
+{
+	size_t checksum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t n = 0; n < reps; ++n) {
+		for (decltype(auto) x : src) checksum += classify(x.get_c());
+	}
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	INC_INFORM(label);
+	INC_INFORM(elapsed.count());
+	INC_INFORM(" microseconds, checksum ");
+	INFORM(checksum);
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<zaimoni::eval_to_ptr<fp_API>::eval_type> src;
+	src.push_back(new var_fp<ISK_INTERVAL<float> >(ISK_INTERVAL<float>(1, 2)));
+	src.push_back(new var_fp<float>(1));
+	src.push_back(new var_fp<ISK_INTERVAL<double> >(ISK_INTERVAL<double>(1, 2)));
+	src.push_back(new var_fp<double>(1));
+	src.push_back(new var_fp<ISK_INTERVAL<long double> >(ISK_INTERVAL<long double>(1, 2)));
+	src.push_back(new var_fp<long double>(1));
+	src.push_back(new var_fp<intmax_t>(1));
+	src.push_back(new var_fp<uintmax_t>(1));
+	src.push_back(new zaimoni::sum());	// not a leaf: worst case for the cascade
+
+	const size_t reps = 1 < argc ? strtoul(argv[1], nullptr, 10) : 1000000;
+	time_it("dynamic_cast cascade: ", by_cascade, src, reps);
+	time_it("leaf_tag switch: ", by_tag, src, reps);
+	return 0;
+}
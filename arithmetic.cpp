@@ -10,6 +10,10 @@
 #include "complex.hpp"
 #include "fp_interchange.hpp"
 #include <typeinfo>
+#include <bit>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
 
 namespace zaimoni {
 
@@ -47,7 +51,45 @@ struct to_float
 namespace math {
 
 	namespace parse_for {
-		// typed_clone destinations must be tested after anything that could clone to them
+		// O(1) leaf classification by fp_API::leaf_tag.  Variant alternatives that are not var_fp are skipped.
+		template<class T> struct leaf_of : public std::integral_constant<fp_leaf, fp_leaf::none> {};
+		template<class T> struct leaf_of<var_fp<T> > : public fp_leaf_tag<T> {};
+
+		template<class Variant, size_t N = 0>
+		std::optional<Variant> _const_leaf(const fp_API* src, fp_leaf tag) {
+			if constexpr (std::variant_size_v<Variant> > N) {
+				using alt = std::remove_const_t<std::remove_pointer_t<std::variant_alternative_t<N, Variant> > >;
+				if (fp_leaf::none != leaf_of<alt>::value && leaf_of<alt>::value == tag) return static_cast<const alt*>(src);
+				return _const_leaf<Variant, N + 1>(src, tag);
+			} else return std::nullopt;
+		}
+
+		template<class Variant>
+		std::optional<Variant> const_leaf(const eval_to_ptr<fp_API>::eval_type& src) {
+			if (const auto x = src.get_c()) return _const_leaf<Variant>(x, x->leaf_tag());
+			return std::nullopt;
+		}
+
+		template<class Variant> std::optional<Variant> leaf(eval_to_ptr<fp_API>::eval_type& src);
+
+		template<class Variant, size_t N = 0>
+		std::optional<Variant> _leaf(eval_to_ptr<fp_API>::eval_type& src, fp_leaf tag) {
+			if constexpr (std::variant_size_v<Variant> > N) {
+				using alt = std::remove_pointer_t<std::variant_alternative_t<N, Variant> >;
+				if (fp_leaf::none != leaf_of<alt>::value && leaf_of<alt>::value == tag) {
+					if (auto x = ptr::writeable<alt>(src)) return x;
+					return leaf<Variant>(src);	// clone changed type, e.g. degenerate interval to its coordinate type
+				}
+				return _leaf<Variant, N + 1>(src, tag);
+			} else return std::nullopt;
+		}
+
+		template<class Variant>
+		std::optional<Variant> leaf(eval_to_ptr<fp_API>::eval_type& src) {
+			if (const auto x = src.get_c()) return _leaf<Variant>(src, x->leaf_tag());
+			return std::nullopt;
+		}
+
 		std::optional<std::variant<var_fp<float>*,
 			var_fp<ISK_INTERVAL<float> >*,
 			var_fp<double>*,
@@ -57,15 +99,7 @@ namespace math {
 			var_fp<intmax_t>*,
 			var_fp<uintmax_t>*
 		> > primitive(eval_to_ptr<fp_API>::eval_type& src) {
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<float> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<float> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<double> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<double> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<long double> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<long double> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<intmax_t> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<uintmax_t> >(src)) return x;
-			return std::nullopt;
+			return leaf<decltype(primitive(src))::value_type>(src);
 		}
 
 		std::optional<std::variant<const var_fp<float>*,
@@ -77,15 +111,7 @@ namespace math {
 			const var_fp<intmax_t>*,
 			const var_fp<uintmax_t>*
 		> > const_primitive(const eval_to_ptr<fp_API>::eval_type& src) {
-			if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<float>*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<double>*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<long double>*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<intmax_t>*>(src.get_c())) return x;
-			if (auto x = dynamic_cast<const var_fp<uintmax_t>* >(src.get_c())) return x;
-			return std::nullopt;
+			return const_leaf<decltype(const_primitive(src))::value_type>(src);
 		}
 	}
 
@@ -329,6 +355,13 @@ namespace math {
 					working[3] = rhs.upper();
 					ret = 0;
 				}
+				if (0 == working[0] || 0 == working[1] || 0 == working[2] || 0 == working[3]) {
+					// an endpoint cancelled out: fp_stats has no exponent for it, so this is as far as we go
+					if (2 != ret || (lhs.lower() == working[0] && lhs.upper() == working[1] && rhs.lower() == working[2] && rhs.upper() == working[3])) return 0;
+					lhs.assign(working[0], working[1]);
+					rhs.assign(working[2], working[3]);
+					return 2;
+				}
 				// version of fp_stats for intervals would make sense here
 			restart:
 				fp_stats<F> stats[4] = { fp_stats<F>(working[0]), fp_stats<F>(working[1]),  fp_stats<F>(working[2]),  fp_stats<F>(working[3]) };
@@ -546,7 +579,6 @@ restart:
 	}
 
 	namespace parse_for {
-		// typed_clone destinations must be tested after anything that could clone to them
 		std::optional<std::variant<var_fp<float>*,
 			var_fp<ISK_INTERVAL<float> >*,
 			var_fp<double>*,
@@ -554,13 +586,7 @@ restart:
 			var_fp<long double>*,
 			var_fp<ISK_INTERVAL<long double> >*
 		> > rearrange_sum(eval_to_ptr<fp_API>::eval_type& src) {
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<float> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<float> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<double> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<double> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<long double> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<long double> >(src)) return x;
-			return std::nullopt;
+			return leaf<decltype(rearrange_sum(src))::value_type>(src);
 		}
 	}
 
@@ -568,10 +594,7 @@ restart:
 		std::optional<std::variant<const var_fp<intmax_t>*,
 			const var_fp<uintmax_t>*
 		> > rearrange_sum(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<intmax_t>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<uintmax_t>*>(test)) return x;
-			return std::nullopt;
+			return parse_for::const_leaf<decltype(rearrange_sum(src))::value_type>(src);
 		}
 	}
 
@@ -732,6 +755,142 @@ exact_product:
 		};
 	}
 
+	// quotients of integer numerals, kept exact
+	namespace rational {
+		struct value {
+			uintmax_t n;	// magnitude
+			uintmax_t d;	// non-zero
+			bool negative;
+			bool n_unsigned;	// preferred representation, when it fits
+			bool d_unsigned;
+		};
+
+		// binary GCD (Stein); gcd(0, x) is x
+		uintmax_t gcd(uintmax_t lhs, uintmax_t rhs) {
+			if (0 == lhs) return rhs;
+			if (0 == rhs) return lhs;
+			const int shift = std::countr_zero(lhs | rhs);
+			lhs >>= std::countr_zero(lhs);
+			do {
+				rhs >>= std::countr_zero(rhs);
+				if (lhs > rhs) std::swap(lhs, rhs);
+				rhs -= lhs;
+			} while (rhs);
+			return lhs << shift;
+		}
+
+		// false on overflow
+		bool mult(uintmax_t lhs, uintmax_t rhs, uintmax_t& dest) {
+#if defined(__SIZEOF_INT128__)
+			const unsigned __int128 test = static_cast<unsigned __int128>(lhs) * rhs;
+			if (UINTMAX_MAX < test) return false;
+			dest = static_cast<uintmax_t>(test);
+			return true;
+#elif defined(_MSC_VER) && defined(_M_X64)
+			uint64_t high;
+			dest = _umul128(lhs, rhs, &high);
+			return 0 == high;
+#else
+			if (0 != lhs && UINTMAX_MAX / lhs < rhs) return false;
+			dest = lhs * rhs;
+			return true;
+#endif
+		}
+
+		// exact, by squaring; std::nullopt on overflow
+		std::optional<uintmax_t> power(uintmax_t x, uintmax_t e) {
+			uintmax_t ret = 1;
+			while (true) {
+				if ((e & 1) && !mult(ret, x, ret)) return std::nullopt;
+				if (!(e >>= 1)) return ret;
+				if (!mult(x, x, x)) return std::nullopt;
+			}
+		}
+
+		// (|x|, x < 0)
+		std::optional<std::pair<uintmax_t, bool> > magnitude(const fp_API& src) {
+			switch (src.leaf_tag()) {
+			case fp_leaf::s_int:
+			{
+				const intmax_t x = static_cast<const var_fp<intmax_t>&>(src)._x;
+				if (0 > x) return std::pair(uintmax_t(-(x + 1)) + 1, true);
+				return std::pair(uintmax_t(x), false);
+			}
+			case fp_leaf::u_int: return std::pair(static_cast<const var_fp<uintmax_t>&>(src)._x, false);
+			default: return std::nullopt;
+			}
+		}
+
+		// integer numerals, and quotients of them; in lowest terms
+		std::optional<value> parse(const COW<fp_API>& src) {
+			const auto x = src.get_c();
+			if (const auto test = magnitude(*x)) {
+				const bool is_unsigned = fp_leaf::u_int == x->leaf_tag();
+				return value{ test->first, 1, test->second, is_unsigned, is_unsigned };
+			}
+			if (const auto q = dynamic_cast<const quotient*>(x)) {
+				const auto n = q->term_c(0)->get_c();
+				const auto d = q->term_c(1)->get_c();
+				const auto n_test = magnitude(*n);
+				if (!n_test) return std::nullopt;
+				const auto d_test = magnitude(*d);
+				if (!d_test || 0 == d_test->first) return std::nullopt;
+				const uintmax_t common = gcd(n_test->first, d_test->first);
+				return value{ n_test->first / common, d_test->first / common, n_test->second != d_test->second, fp_leaf::u_int == n->leaf_tag(), fp_leaf::u_int == d->leaf_tag() };
+			}
+			return std::nullopt;
+		}
+
+		// std::nullopt on overflow.  Cross-cancelling first keeps canonical operands' product canonical.
+		std::optional<value> product(const value& lhs, const value& rhs) {
+			const uintmax_t l_common = gcd(lhs.n, rhs.d);
+			const uintmax_t r_common = gcd(rhs.n, lhs.d);
+			value ret{ 0, 0, lhs.negative != rhs.negative, lhs.n_unsigned && rhs.n_unsigned, lhs.d_unsigned && rhs.d_unsigned };
+			if (!mult(lhs.n / l_common, rhs.n / r_common, ret.n)) return std::nullopt;
+			if (!mult(lhs.d / r_common, rhs.d / l_common, ret.d)) return std::nullopt;
+			if (0 == ret.n) {
+				ret.d = 1;
+				ret.negative = false;
+			}
+			return ret;
+		}
+
+		// null if not representable
+		COW<fp_API> integer(uintmax_t x, bool negative, bool prefer_unsigned) {
+			if (negative && 0 != x) {
+				if (uintmax_t(INTMAX_MAX) + 1 < x) return COW<fp_API>();
+				return COW<fp_API>(std::in_place_type<var_fp<intmax_t> >, -intmax_t(x - 1) - 1);
+			}
+			if (prefer_unsigned || uintmax_t(INTMAX_MAX) < x) return COW<fp_API>(std::in_place_type<var_fp<uintmax_t> >, x);
+			return COW<fp_API>(std::in_place_type<var_fp<intmax_t> >, intmax_t(x));
+		}
+
+		// sign goes on the numerator
+		std::optional<std::pair<COW<fp_API>, COW<fp_API> > > terms(const value& src) {
+			auto n = integer(src.n, src.negative, src.n_unsigned);
+			if (!n) return std::nullopt;
+			return std::pair(std::move(n), integer(src.d, false, src.d_unsigned));
+		}
+	}
+
+	bool canonical_quotient(COW<fp_API>& n, COW<fp_API>& d) {
+		const auto num = rational::parse(n);
+		if (!num) return false;
+		auto den = rational::parse(d);
+		if (!den || 0 == den->n) return false;
+		std::swap(den->n, den->d);
+		std::swap(den->n_unsigned, den->d_unsigned);
+		const auto x = rational::product(*num, *den);
+		if (!x) return false;
+		// already canonical: two numerals, coprime, denominator positive
+		if (1 == num->d && 1 == den->n && x->n == num->n && x->d == den->d && !den->negative) return false;
+		auto stage = rational::terms(*x);
+		if (!stage) return false;
+		n = std::move(stage->first);
+		d = std::move(stage->second);
+		return true;
+	}
+
 	namespace parse_for {
 		std::optional<std::variant<const var_fp<float>*,
 			const var_fp<ISK_INTERVAL<float> >*,
@@ -740,14 +899,7 @@ exact_product:
 			const var_fp<long double>*,
 			const var_fp<ISK_INTERVAL<long double> >*
 		> > rearrange_product(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<float>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<double>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<long double>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(test)) return x;
-			return std::nullopt;
+			return const_leaf<decltype(rearrange_product(src))::value_type>(src);
 		}
 	}
 
@@ -755,10 +907,7 @@ exact_product:
 		std::optional<std::variant<const var_fp<intmax_t>*,
 			const var_fp<uintmax_t>*
 		> > rearrange_product(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<intmax_t>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<uintmax_t>*>(test)) return x;
-			return std::nullopt;
+			return parse_for::const_leaf<decltype(rearrange_product(src))::value_type>(src);
 		}
 	}
 
@@ -776,6 +925,20 @@ exact_product:
 			}
 		}
 
+		if (const auto l = rational::parse(lhs)) {
+			if (const auto r = rational::parse(rhs)) {
+				if (const auto x = rational::product(*l, *r)) {
+					if (auto stage = rational::terms(*x)) {
+						if (1 == x->d) lhs = std::move(stage->first);
+						else lhs = COW<fp_API>(std::in_place_type<quotient>, std::move(stage->first), std::move(stage->second));
+						rhs = rational::integer(1, false, r->n_unsigned);
+						return 1;
+					}
+				}
+				return 0;	// overflow: other factors may yet cancel
+			}
+		}
+
 		if (unhandled::rearrange_product(lhs) && unhandled::rearrange_product(rhs)) {
 			auto err = std::string("need to build out zaimoni::math::rearrange_product: ") + std::visit(type_to_str(), *unhandled::rearrange_product(lhs)) + ", " + std::visit(type_to_str(), *unhandled::rearrange_product(rhs));
 			throw new std::logic_error(err);
@@ -847,7 +1010,6 @@ exact_product:
 	}
 
 	namespace parse_for {
-		// typed_clone destinations must be tested after anything that could clone to them
 		std::optional<std::variant<const var_fp<float>*,
 			const var_fp<ISK_INTERVAL<float> >*,
 			const var_fp<double>*,
@@ -855,14 +1017,7 @@ exact_product:
 			const var_fp<long double>*,
 			const var_fp<ISK_INTERVAL<long double> >*
 		> > eval_product(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<float>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<long double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(test)) return x;
-			return std::nullopt;
+			return const_leaf<decltype(eval_product(src))::value_type>(src);
 		}
 	}
 
@@ -870,10 +1025,7 @@ exact_product:
 		std::optional<std::variant<const var_fp<intmax_t>*,
 			const var_fp<uintmax_t>*
 		> > eval_product(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<intmax_t>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<uintmax_t>*>(test)) return x;
-			return std::nullopt;
+			return parse_for::const_leaf<decltype(eval_product(src))::value_type>(src);
 		}
 	}
 
@@ -887,6 +1039,10 @@ exact_product:
 			if (unhandled::eval_product(rhs)) throw std::logic_error("need to build out zaimoni::math::eval_product");
 			if (parse_for::eval_product(rhs)) throw std::logic_error("need to build out zaimoni::math::eval_product");
 		}
+		if (auto l = dynamic_cast<const API_product<fp_API>*>(lhs.get_c())) {
+			if (auto ret = l->eval_product(rhs)) return ret;
+		}
+		if (auto r = dynamic_cast<const API_product<fp_API>*>(rhs.get_c())) return r->eval_product(lhs);	// \todo not if product is non-commutative
 		return nullptr;
 	}
 
@@ -924,11 +1080,48 @@ exact_product:
 		return std::numeric_limits<int>::min();
 	}
 
+	std::optional<product_cost_class> cost_class(const COW<fp_API>& x)
+	{
+		auto component = [](const fp_API& src) -> std::optional<product_cost_class::component> {
+			switch (const auto tag = src.leaf_tag()) {
+			case fp_leaf::none: return std::nullopt;
+			case fp_leaf::s_int:
+			case fp_leaf::u_int: return product_cost_class::integer;
+			default:
+				if (!is_interval(tag)) return product_cost_class::point;
+				return 0 == src.sgn() ? product_cost_class::signed_interval : product_cost_class::interval;
+			}
+		};
+
+		const auto src = x.get_c();
+		if (const auto test = component(*src)) return product_cost_class{ *test, false };
+		if (!dynamic_cast<const API_product<fp_API>*>(src)) return std::nullopt;
+		product_cost_class ret{ product_cost_class::integer, true };
+		const size_t ub = src->arity();
+		for (size_t i = 0; i < ub; ++i) {
+			const auto test = component(*src->term_c(i)->get_c());
+			if (!test) return std::nullopt;
+			if (ret.leaf < *test) ret.leaf = *test;
+		}
+		return ret;
+	}
+
+	// as ISK_INTERVAL's operator*=, which rounds each bound its own way; complex-like factors as complex::product_op_count
+	std::pair<int, int> op_count_product(const product_cost_class& lhs, const product_cost_class& rhs)
+	{
+		std::pair<int, int> ret(0, 2);
+		if (product_cost_class::integer == lhs.leaf || product_cost_class::integer == rhs.leaf) ret = std::pair(0, 1);	// exact, or not multiplied at all (update_op_count_product's default)
+		else if (product_cost_class::signed_interval == lhs.leaf && product_cost_class::signed_interval == rhs.leaf) ret = std::pair(2, 4);
+		if (lhs.complex && rhs.complex) return std::pair(2 + 4 * ret.first, 4 * ret.second);
+		if (lhs.complex || rhs.complex) return std::pair(2 * ret.first, 2 * ret.second);
+		return ret;
+	}
+
 	static std::optional<std::pair<int, int> > op_count_product(const COW<fp_API>& lhs, const COW<fp_API>& rhs)
 	{
 		auto elementary_lhs = parse_for::eval_product(lhs);
 		auto elementary_rhs = parse_for::eval_product(rhs);
-		if (elementary_lhs && elementary_rhs) return std::pair(0, 1);
+		if (elementary_lhs && elementary_rhs) return op_count_product(*cost_class(lhs), *cost_class(rhs));
 		auto API_lhs = elementary_lhs ? nullptr : dynamic_cast<const API_product<fp_API>*>(lhs.get_c());
 		auto API_rhs = elementary_rhs ? nullptr : dynamic_cast<const API_product<fp_API>*>(rhs.get_c());
 		if (API_lhs) {
@@ -1032,7 +1225,6 @@ exact_product:
 	}
 
 	namespace parse_for {
-		// typed_clone destinations must be tested after anything that could clone to them
 		std::optional<std::variant<const var_fp<float>*,
 			const var_fp<ISK_INTERVAL<float> >*,
 			const var_fp<double>*,
@@ -1040,14 +1232,7 @@ exact_product:
 			const var_fp<long double>*,
 			const var_fp<ISK_INTERVAL<long double> >*
 		> > eval_quotient(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<float>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<long double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(test)) return x;
-			return std::nullopt;
+			return const_leaf<decltype(eval_quotient(src))::value_type>(src);
 		}
 	}
 
@@ -1055,10 +1240,7 @@ exact_product:
 		std::optional<std::variant<const var_fp<intmax_t>*,
 			const var_fp<uintmax_t>*
 		> > eval_quotient(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<intmax_t>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<uintmax_t>*>(test)) return x;
-			return std::nullopt;
+			return parse_for::const_leaf<decltype(eval_quotient(src))::value_type>(src);
 		}
 	}
 
@@ -1085,9 +1267,61 @@ exact_product:
 		return nullptr;
 	}
 
+	// eval_power support
+	namespace _eval {
+		// exponentiation by squaring; the interval operations round outward at each step
+		class power {
+		private:
+			int _e;
+
+		public:
+			power(int e) noexcept : _e(e) {}
+
+			template<std::floating_point F> fp_API* operator()(const ISK_INTERVAL<F>& x) {
+				if (isINF(x.lower()) || isINF(x.upper())) return nullptr;
+				try {
+					const auto ret = 0 > _e ? ISK_INTERVAL<F>(1) / pow(x, -_e) : pow(x, _e);
+					if (isINF(ret.lower()) || isINF(ret.upper())) {	// overflowed: upgrade resolution
+						if constexpr (std::is_same_v<F, float>) return operator()(ISK_INTERVAL<double>(x));
+						else if constexpr (std::is_same_v<F, double> && std::numeric_limits<double>::max_exponent < std::numeric_limits<long double>::max_exponent) return operator()(ISK_INTERVAL<long double>(x));
+						else return nullptr;
+					}
+					if (ret.lower() == ret.upper()) return new var_fp<F>(ret.upper());
+					return new var_fp<ISK_INTERVAL<F> >(ret);
+				} catch (zaimoni::math::numeric_error& e) {
+					return nullptr;
+				}
+			}
+
+			template<std::floating_point F> fp_API* operator()(const F& x) { return operator()(ISK_INTERVAL<F>(x)); }
+			template<class T> fp_API* operator()(const var_fp<T>* x) { return operator()(x->_x); }
+		};
+	}
+
+	fp_API* eval_power(const COW<fp_API>& base, const COW<fp_API>& exponent)
+	{
+		const auto e = rational::magnitude(*exponent.get_c());
+		if (!e || 0 == e->first || INT_MAX < e->first) return nullptr;
+		const int n = e->second ? -int(e->first) : int(e->first);
+
+		if (const auto b = rational::magnitude(*base.get_c())) {
+			if (0 == b->first) return nullptr;
+			if (const auto x = rational::power(b->first, e->first)) {
+				if (auto ret = rational::integer(*x, b->second && (e->first & 1), fp_leaf::u_int == base.get_c()->leaf_tag())) {
+					if (e->second) return new quotient(rational::integer(1, false, false), std::move(ret));
+					return ret.release();
+				}
+			}
+			// overflowed: floating-point
+			if (auto x = std::visit(to_float(), *unhandled::eval_quotient(base))) return std::visit(_eval::power(n), *x);
+			return nullptr;
+		}
+		if (auto x = parse_for::eval_quotient(base)) return std::visit(_eval::power(n), *x);
+		return nullptr;
+	}
+
 	namespace parse_for {
 		// uintmax_t intentionally omitted
-		// typed_clone destinations must be tested after anything that could clone to them
 		std::optional<std::variant<const var_fp<float>*,
 			const var_fp<ISK_INTERVAL<float> >*,
 			const var_fp<double>*,
@@ -1095,14 +1329,7 @@ exact_product:
 			const var_fp<long double>*,
 			const var_fp<ISK_INTERVAL<long double> >*
 		> > sum_score(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<float>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<long double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(test)) return x;
-			return std::nullopt;
+			return const_leaf<decltype(sum_score(src))::value_type>(src);
 		}
 	}
 
@@ -1115,6 +1342,9 @@ exact_product:
 		{
 			template<std::floating_point F> int operator()(const ISK_INTERVAL<F>& x)
 			{
+				// a zero endpoint has no exponent; the other one decides
+				if (0 == x.lower()) return operator()(x.upper());
+				if (0 == x.upper()) return operator()(x.lower());
 				fp_stats<F> test_l(x.lower());
 				fp_stats<F> test_r(x.upper());
 				return std::numeric_limits<long double>::max_exponent - (test_l.exponent() < test_r.exponent() ? test_l.exponent() : test_r.exponent());
@@ -1233,14 +1463,7 @@ exact_product:
 			const var_fp<long double>*,
 			const var_fp<ISK_INTERVAL<long double> >*
 		> > eval_sum(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<float>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<float> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<double> >*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<long double>*>(test)) return x;
-			else if (auto x = dynamic_cast<const var_fp<ISK_INTERVAL<long double> >*>(test)) return x;
-			return std::nullopt;
+			return const_leaf<decltype(eval_sum(src))::value_type>(src);
 		}
 	}
 
@@ -1248,10 +1471,7 @@ exact_product:
 		std::optional<std::variant<const var_fp<intmax_t>*,
 			const var_fp<uintmax_t>*
 		> > eval_sum(const eval_to_ptr<fp_API>::eval_type& src) {
-			auto test = src.get_c();
-			if (auto x = dynamic_cast<const var_fp<intmax_t>*>(test)) return x;
-			if (auto x = dynamic_cast<const var_fp<uintmax_t>*>(test)) return x;
-			return std::nullopt;
+			return parse_for::const_leaf<decltype(eval_sum(src))::value_type>(src);
 		}
 	}
 
@@ -1283,7 +1503,6 @@ exact_product:
 
 	namespace parse_for {
 		// uintmax_t intentionally omitted
-		// typed_clone destinations must be tested after anything that could clone to them
 		std::optional<std::variant<API_addinv*,
 			var_fp<float>*,
 			var_fp<ISK_INTERVAL<float> >*,
@@ -1294,14 +1513,7 @@ exact_product:
 			var_fp<intmax_t>*
 		> > negate(eval_to_ptr<fp_API>::eval_type& src) {
 			if (auto x = ptr::writeable<API_addinv>(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<float> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<float> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<double> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<double> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<ISK_INTERVAL<long double> > >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<long double> >(src)) return x;
-			if (auto x = ptr::writeable<var_fp<intmax_t> >(src)) return x;
-			return std::nullopt;
+			return leaf<decltype(negate(src))::value_type>(src);
 		}
 	}
 
@@ -1339,23 +1551,23 @@ retry:
 		if (auto r = x.get_rw<var_fp<float> >()) {
 			auto test = r->second;
 			if (would_overflow<decltype(test->_x)>::square(test->_x)) { // upgrade resolution
-				x = std::unique_ptr<fp_API>(new var_fp<double>(test->_x));
+				x = COW<fp_API>(std::in_place_type<var_fp<double> >, test->_x);
 				goto upgrade_double;
 			}
 			auto stage = square(ISK_INTERVAL<float>(test->_x));
 			if (auto rewrite = zaimoni::detail::var_fp_impl<decltype(stage)>::clone(stage)) x = std::unique_ptr<fp_API>(rewrite);
-			else x = std::unique_ptr<fp_API>(new var_fp<decltype(stage)>(stage));
+			else x = COW<fp_API>(std::in_place_type<var_fp<decltype(stage)> >, stage);
 			return true;
 		}
 		if (auto r = x.get_rw<var_fp<ISK_INTERVAL<float> > >()) {
 			auto test = r->second;
 			if (would_overflow<decltype(test->_x)>::square(test->_x)) { // upgrade resolution
-				x = std::unique_ptr<fp_API>(new var_fp<ISK_INTERVAL<double> >(test->_x));
+				x = COW<fp_API>(std::in_place_type<var_fp<ISK_INTERVAL<double> > >, test->_x);
 				goto upgrade_interval_double;
 			}
 			auto stage = square(test->_x);
 			if (auto rewrite = zaimoni::detail::var_fp_impl<decltype(stage)>::clone(stage)) x = std::unique_ptr<fp_API>(rewrite);
-			else x = std::unique_ptr<fp_API>(new var_fp<decltype(stage)>(stage));
+			else x = COW<fp_API>(std::in_place_type<var_fp<decltype(stage)> >, stage);
 			return true;
 		}
 upgrade_double:
@@ -1370,7 +1582,7 @@ upgrade_double:
 			}
 			auto stage = square(ISK_INTERVAL<double>(test->_x));
 			if (auto rewrite = zaimoni::detail::var_fp_impl<decltype(stage)>::clone(stage)) x = std::unique_ptr<fp_API>(rewrite);
-			else x = std::unique_ptr<fp_API>(new var_fp<decltype(stage)>(stage));
+			else x = COW<fp_API>(std::in_place_type<var_fp<decltype(stage)> >, stage);
 			return true;
 		}
 upgrade_interval_double:
@@ -1385,7 +1597,7 @@ upgrade_interval_double:
 			}
 			auto stage = square(test->_x);
 			if (auto rewrite = zaimoni::detail::var_fp_impl<decltype(stage)>::clone(stage)) x = std::unique_ptr<fp_API>(rewrite);
-			else x = std::unique_ptr<fp_API>(new var_fp<decltype(stage)>(stage));
+			else x = COW<fp_API>(std::in_place_type<var_fp<decltype(stage)> >, stage);
 			return true;
 		}
 		if (auto r = x.get_rw<var_fp<long double> >()) {
@@ -1399,7 +1611,7 @@ upgrade_interval_double:
 			}
 			auto stage = square(ISK_INTERVAL<long double>(test->_x));
 			if (auto rewrite = zaimoni::detail::var_fp_impl<decltype(stage)>::clone(stage)) x = std::unique_ptr<fp_API>(rewrite);
-			else x = std::unique_ptr<fp_API>(new var_fp<decltype(stage)>(stage));
+			else x = COW<fp_API>(std::in_place_type<var_fp<decltype(stage)> >, stage);
 			return true;
 		}
 		if (auto r = x.get_rw< var_fp<ISK_INTERVAL<long double> > >()) {
@@ -1413,7 +1625,7 @@ upgrade_interval_double:
 			}
 			auto stage = square(test->_x);
 			if (auto rewrite = zaimoni::detail::var_fp_impl<decltype(stage)>::clone(stage)) x = std::unique_ptr<fp_API>(rewrite);
-			else x = std::unique_ptr<fp_API>(new var_fp<decltype(stage)>(stage));
+			else x = COW<fp_API>(std::in_place_type<var_fp<decltype(stage)> >, stage);
 			return true;
 		}
 		if (auto r = x.get_rw<power_fp>()) {
@@ -1449,62 +1661,166 @@ symbolic_overflow:
 			return false;
 		}
 	}
-}	// namespace math
 
-eval_to_ptr<fp_API>::eval_type operator+(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs)
-{
-	std::unique_ptr<sum> ret(new sum());
-	ret->append_term(lhs);
-	ret->append_term(rhs);
-	return eval_to_ptr<fp_API>::eval_type(ret.release());
-}
+	namespace _eval {
+		// a leaf enclosed at precision F (rounding outward, so promotion is exact); nullptr if it is at F already
+		template<std::floating_point F>
+		struct at_precision {
+			template<std::floating_point F2> static F round_down(F2 x) {
+				F ret = static_cast<F>(x);	// in whatever rounding mode was left set
+				if (static_cast<long double>(ret) > static_cast<long double>(x)) ret = std::nextafter(ret, -std::numeric_limits<F>::infinity());
+				return ret;
+			}
 
-eval_to_ptr<fp_API>::eval_type& operator+=(eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs)
-{
-	if (auto r = lhs.get_rw<sum>()) {
-		if (!r->first) lhs = std::unique_ptr<fp_API>(r->first = r->second->typed_clone());
-		r->first->append_term(rhs);
-	} else {
-		lhs = lhs + rhs;
+			template<std::floating_point F2> static F round_up(F2 x) {
+				F ret = static_cast<F>(x);
+				if (static_cast<long double>(ret) < static_cast<long double>(x)) ret = std::nextafter(ret, std::numeric_limits<F>::infinity());
+				return ret;
+			}
+
+			template<std::floating_point F2> static fp_API* enclose(F2 lb, F2 ub) {
+				const F l = round_down(lb);
+				const F u = round_up(ub);
+				if (l == u) return new var_fp<F>(l);
+				return new var_fp<ISK_INTERVAL<F> >(ISK_INTERVAL<F>(l, u));
+			}
+
+			template<std::floating_point F2> fp_API* operator()(const var_fp<F2>* x) {
+				if constexpr (std::is_same_v<F, F2>) return nullptr;
+				else return enclose(x->_x, x->_x);
+			}
+
+			template<std::floating_point F2> fp_API* operator()(const var_fp<ISK_INTERVAL<F2> >* x) {
+				if constexpr (std::is_same_v<F, F2>) return nullptr;
+				else return enclose(x->_x.lower(), x->_x.upper());
+			}
+
+			fp_API* operator()(const var_fp<intmax_t>*) { return nullptr; }	// exact already
+			fp_API* operator()(const var_fp<uintmax_t>*) { return nullptr; }
+		};
+
+		struct width {
+			template<std::floating_point F> long double operator()(const var_fp<F>*) { return 0; }
+			template<std::floating_point F> long double operator()(const var_fp<ISK_INTERVAL<F> >* x) { return x->_x.width(); }
+			long double operator()(const var_fp<intmax_t>*) { return 0; }
+			long double operator()(const var_fp<uintmax_t>*) { return 0; }
+		};
 	}
 
-	return lhs;
-}
+	template<std::floating_point F>
+	static void to_precision(COW<fp_API>& x)
+	{
+		if (x.get_c()->arity()) {
+			auto dest = x.get();	// clones if shared
+			for (size_t i = 0, ub = dest->arity(); i < ub; ++i) to_precision<F>(*dest->term(i));
+			return;
+		}
+		if (auto test = parse_for::const_primitive(x)) {
+			if (auto dest = std::visit(_eval::at_precision<F>(), *test)) x = std::unique_ptr<fp_API>(dest);
+		}
+	}
+
+	template<std::floating_point F>
+	static COW<fp_API> eval_at_precision(const COW<fp_API>& src)
+	{
+		COW<fp_API> ret(src);
+		to_precision<F>(ret);
+		while (fp_API::eval(ret));
+		return ret;
+	}
 
-eval_to_ptr<fp_API>::eval_type operator*(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs)
+	static long double leaf_width(const COW<fp_API>& x)
+	{
+		if (auto test = parse_for::const_primitive(x)) return std::visit(_eval::width(), *test);
+		return std::numeric_limits<long double>::infinity();	// did not evaluate to a leaf
+	}
+
+	COW<fp_API> eval_to_tolerance(const COW<fp_API>& src, long double tolerance)
+	{
+		COW<fp_API> ret;
+		std::exception_ptr error;
+		auto attempt = [&](COW<fp_API> (*eval)(const COW<fp_API>&)) {	// true if ret is good enough
+			try {
+				ret = eval(src);
+				return leaf_width(ret) <= tolerance;
+			} catch (const std::logic_error& e) {	// not implemented at this precision
+				if (!error) error = std::current_exception();
+			} catch (zaimoni::math::numeric_error& e) {	// e.g. overflow
+				if (!error) error = std::current_exception();
+			}
+			return false;
+		};
+		if (attempt(eval_at_precision<float>)) return ret;
+		if (attempt(eval_at_precision<double>)) return ret;
+		if constexpr (std::numeric_limits<double>::digits < std::numeric_limits<long double>::digits) attempt(eval_at_precision<long double>);
+		if (!ret) std::rethrow_exception(error);
+		return ret;
+	}
+}	// namespace math
+
+// Forwarding references: const lvalues are copied, rvalues are moved.
+template<class N, class L, class R>
+static eval_to_ptr<fp_API>::eval_type _n_ary(L&& lhs, R&& rhs)
 {
-	std::unique_ptr<product> ret(new product());
-	ret->append_term(lhs);
-	ret->append_term(rhs);
+	if constexpr (!std::is_const_v<std::remove_reference_t<L> >) {
+		if (auto r = lhs.template get_rw<N>(); r && r->first) {	// we own it: append in place
+			r->first->append_term(std::forward<R>(rhs));
+			return std::move(lhs);
+		}
+	}
+	std::unique_ptr<N> ret(new N());
+	ret->append_term(std::forward<L>(lhs));
+	ret->append_term(std::forward<R>(rhs));
 	return eval_to_ptr<fp_API>::eval_type(ret.release());
 }
 
-eval_to_ptr<fp_API>::eval_type& operator*=(eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs)
+template<class N, class R>
+static eval_to_ptr<fp_API>::eval_type& _n_ary_assign(eval_to_ptr<fp_API>::eval_type& lhs, R&& rhs)
 {
-	if (auto r = lhs.get_rw<product>()) {
+	if (auto r = lhs.get_rw<N>()) {
 		if (!r->first) lhs = std::unique_ptr<fp_API>(r->first = r->second->typed_clone());
-		r->first->append_term(rhs);
+		r->first->append_term(std::forward<R>(rhs));
 	} else {
-		lhs = lhs * rhs;
+		lhs = _n_ary<N>(std::move(lhs), std::forward<R>(rhs));
 	}
 
 	return lhs;
 }
 
-eval_to_ptr<fp_API>::eval_type operator/(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs)
+template<class L, class R>
+static eval_to_ptr<fp_API>::eval_type _quotient(L&& lhs, R&& rhs)
 {
-	if (lhs->is_one()) {
-		auto stage = std::unique_ptr<symbolic_fp>(new symbolic_fp(rhs));
+	if (lhs.get_c()->is_one()) {
+		auto stage = std::unique_ptr<symbolic_fp>(new symbolic_fp(std::forward<R>(rhs)));
 		stage->self_multinv();
 		return stage.release();
 	}
-	return new quotient(lhs, rhs);
+	return new quotient(std::forward<L>(lhs), std::forward<R>(rhs));
 }
 
+eval_to_ptr<fp_API>::eval_type operator+(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _n_ary<sum>(lhs, rhs); }
+eval_to_ptr<fp_API>::eval_type operator+(eval_to_ptr<fp_API>::eval_type&& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _n_ary<sum>(std::move(lhs), rhs); }
+eval_to_ptr<fp_API>::eval_type operator+(const eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _n_ary<sum>(lhs, std::move(rhs)); }
+eval_to_ptr<fp_API>::eval_type operator+(eval_to_ptr<fp_API>::eval_type&& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _n_ary<sum>(std::move(lhs), std::move(rhs)); }
+eval_to_ptr<fp_API>::eval_type& operator+=(eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _n_ary_assign<sum>(lhs, rhs); }
+eval_to_ptr<fp_API>::eval_type& operator+=(eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _n_ary_assign<sum>(lhs, std::move(rhs)); }
+
+eval_to_ptr<fp_API>::eval_type operator*(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _n_ary<product>(lhs, rhs); }
+eval_to_ptr<fp_API>::eval_type operator*(eval_to_ptr<fp_API>::eval_type&& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _n_ary<product>(std::move(lhs), rhs); }
+eval_to_ptr<fp_API>::eval_type operator*(const eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _n_ary<product>(lhs, std::move(rhs)); }
+eval_to_ptr<fp_API>::eval_type operator*(eval_to_ptr<fp_API>::eval_type&& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _n_ary<product>(std::move(lhs), std::move(rhs)); }
+eval_to_ptr<fp_API>::eval_type& operator*=(eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _n_ary_assign<product>(lhs, rhs); }
+eval_to_ptr<fp_API>::eval_type& operator*=(eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _n_ary_assign<product>(lhs, std::move(rhs)); }
+
+eval_to_ptr<fp_API>::eval_type operator/(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _quotient(lhs, rhs); }
+eval_to_ptr<fp_API>::eval_type operator/(eval_to_ptr<fp_API>::eval_type&& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) { return _quotient(std::move(lhs), rhs); }
+eval_to_ptr<fp_API>::eval_type operator/(const eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _quotient(lhs, std::move(rhs)); }
+eval_to_ptr<fp_API>::eval_type operator/(eval_to_ptr<fp_API>::eval_type&& lhs, eval_to_ptr<fp_API>::eval_type&& rhs) { return _quotient(std::move(lhs), std::move(rhs)); }
+
 void negate_in_place(eval_to_ptr<fp_API>::eval_type& lhs)
 {
 	if (!zaimoni::math::in_place_negate(lhs)) {
-		std::unique_ptr<symbolic_fp> staging(new symbolic_fp(lhs));
+		std::unique_ptr<symbolic_fp> staging(new symbolic_fp(std::move(lhs)));
 		staging->self_negate();
 		lhs = staging.release();
 	}
@@ -1517,6 +1833,12 @@ eval_to_ptr<fp_API>::eval_type operator-(const eval_to_ptr<fp_API>::eval_type& l
 	return ret;
 }
 
+eval_to_ptr<fp_API>::eval_type operator-(eval_to_ptr<fp_API>::eval_type&& lhs)
+{
+	negate_in_place(lhs);
+	return std::move(lhs);
+}
+
 COW<fp_API> scalBn(const COW<fp_API>& src, intmax_t scale) {
 	auto ret(src);
 	ret->scal_bn(scale);
@@ -1529,6 +1851,10 @@ eval_to_ptr<fp_API>::eval_type pow(const eval_to_ptr<fp_API>::eval_type& base, c
 	return eval_to_ptr<fp_API>::eval_type(new power_fp(base, exponent));
 }
 
+eval_to_ptr<fp_API>::eval_type pow(eval_to_ptr<fp_API>::eval_type&& base, const eval_to_ptr<fp_API>::eval_type& exponent) { return eval_to_ptr<fp_API>::eval_type(new power_fp(std::move(base), exponent)); }
+eval_to_ptr<fp_API>::eval_type pow(const eval_to_ptr<fp_API>::eval_type& base, eval_to_ptr<fp_API>::eval_type&& exponent) { return eval_to_ptr<fp_API>::eval_type(new power_fp(base, std::move(exponent))); }
+eval_to_ptr<fp_API>::eval_type pow(eval_to_ptr<fp_API>::eval_type&& base, eval_to_ptr<fp_API>::eval_type&& exponent) { return eval_to_ptr<fp_API>::eval_type(new power_fp(std::move(base), std::move(exponent))); }
+
 }	// namespace zaimoni
 
 #ifdef TEST_APP
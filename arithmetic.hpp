@@ -16,10 +16,31 @@ int product_score(const COW<fp_API>& lhs);
 int product_score(const COW<fp_API>& lhs, const COW<fp_API>& rhs);
 // (+, *) elementary operation counts
 void update_op_count_product(const COW<fp_API>& lhs, const COW<fp_API>& rhs, std::pair<int, int>& accumulator);
+
+// what multiplying a factor costs: its real components, and whether it is complex-like (API_product)
+struct product_cost_class {
+	enum component : unsigned char {
+		integer = 0,	// exact
+		point,		// rounded both ways: two multiplies
+		interval,
+		signed_interval	// sgn 0: against another, four multiplies and two comparisons
+	};
+	component leaf;
+	bool complex;
+
+	// the class of the product
+	friend product_cost_class operator*(const product_cost_class& lhs, const product_cost_class& rhs) {
+		return product_cost_class{ lhs.leaf < rhs.leaf ? rhs.leaf : lhs.leaf, lhs.complex || rhs.complex };
+	}
+};
+std::optional<product_cost_class> cost_class(const COW<fp_API>& x);	// numeral leaves, and complex-like numbers of them
+std::pair<int, int> op_count_product(const product_cost_class& lhs, const product_cost_class& rhs);
 COW<fp_API> eval_product(const COW<fp_API>& lhs, const COW<fp_API>& rhs);
 COW<fp_API> mult_identity(const type& src);
 
 fp_API* eval_quotient(const COW<fp_API>& n, const COW<fp_API>& d);
+fp_API* eval_power(const COW<fp_API>& base, const COW<fp_API>& exponent);	// integer exponents
+bool canonical_quotient(COW<fp_API>& n, COW<fp_API>& d);	// integer numerals (or quotients of them) to lowest terms, positive denominator
 
 int sum_score(const COW<fp_API>& x); // i.e., do we have a backend for this
 int sum_score(const COW<fp_API>& lhs, const COW<fp_API>& rhs);
@@ -30,19 +51,40 @@ bool in_place_negate(eval_to_ptr<fp_API>::eval_type& lhs);
 bool in_place_square(COW<fp_API>& x);
 bool scal_bn(COW<fp_API>& x, intmax_t& scale);
 
+// while (fp_API::eval(x)); on a copy whose floating-point leaves are enclosed at float precision, then double, then long
+// double, until the result is a leaf no wider than tolerance.  A precision that throws is skipped; otherwise the most
+// precise result is returned regardless.
+COW<fp_API> eval_to_tolerance(const COW<fp_API>& src, long double tolerance);
+
 }
 
+// rvalue operands are moved into the result rather than copied; an rvalue sum (product) on the left is appended to
 eval_to_ptr<fp_API>::eval_type operator+(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type operator+(eval_to_ptr<fp_API>::eval_type&& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type operator+(const eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
+eval_to_ptr<fp_API>::eval_type operator+(eval_to_ptr<fp_API>::eval_type&& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
 eval_to_ptr<fp_API>::eval_type& operator+=(eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type& operator+=(eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
 
 eval_to_ptr<fp_API>::eval_type operator*(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type operator*(eval_to_ptr<fp_API>::eval_type&& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type operator*(const eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
+eval_to_ptr<fp_API>::eval_type operator*(eval_to_ptr<fp_API>::eval_type&& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
 eval_to_ptr<fp_API>::eval_type& operator*=(eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type& operator*=(eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
 eval_to_ptr<fp_API>::eval_type operator/(const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type operator/(eval_to_ptr<fp_API>::eval_type&& lhs, const eval_to_ptr<fp_API>::eval_type& rhs);
+eval_to_ptr<fp_API>::eval_type operator/(const eval_to_ptr<fp_API>::eval_type& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
+eval_to_ptr<fp_API>::eval_type operator/(eval_to_ptr<fp_API>::eval_type&& lhs, eval_to_ptr<fp_API>::eval_type&& rhs);
 
 void negate_in_place(eval_to_ptr<fp_API>::eval_type& lhs);
 eval_to_ptr<fp_API>::eval_type operator-(const eval_to_ptr<fp_API>::eval_type& lhs);
+eval_to_ptr<fp_API>::eval_type operator-(eval_to_ptr<fp_API>::eval_type&& lhs);
 
 eval_to_ptr<fp_API>::eval_type pow(const eval_to_ptr<fp_API>::eval_type& base, const eval_to_ptr<fp_API>::eval_type& exponent);
+eval_to_ptr<fp_API>::eval_type pow(eval_to_ptr<fp_API>::eval_type&& base, const eval_to_ptr<fp_API>::eval_type& exponent);
+eval_to_ptr<fp_API>::eval_type pow(const eval_to_ptr<fp_API>::eval_type& base, eval_to_ptr<fp_API>::eval_type&& exponent);
+eval_to_ptr<fp_API>::eval_type pow(eval_to_ptr<fp_API>::eval_type&& base, eval_to_ptr<fp_API>::eval_type&& exponent);
 
 }
 
@@ -3,12 +3,23 @@
 #include "Zaimoni.STL/interval.hpp"
 
 // #include "quotient.hpp"
+#include "power_fp.hpp"
 #include "product.hpp"
 #include "sum.hpp"
+#include "complex.hpp"
+#include "intern.hpp"
+#include "evaluator.hpp"
+#include "egraph.hpp"
+#include "serial.hpp"
+#include "tape.hpp"
 
 #include "test_driver.h"
 
 #include <array>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <thread>
 
 auto bootstrap_int(intmax_t src)
 {
@@ -32,8 +43,46 @@ static constexpr const char* primitive_numeric[] = {
 	"intmax_t", "uintmax_t"
 };
 
+// the built-in domains, by arch_domain; the dynamic_casts are what the virtual subclass tests are built on
+template<zaimoni::_type_spec::arch_domain DOM> static const zaimoni::math::type* builtin_domain() { return &zaimoni::math::get<zaimoni::_type<DOM> >(); }
+template<zaimoni::_type_spec::arch_domain DOM> static bool is_builtin_domain(const zaimoni::math::type* x) { return dynamic_cast<const zaimoni::_type<DOM>*>(x); }
+
+static constexpr std::pair<const zaimoni::math::type* (*)(), bool (*)(const zaimoni::math::type*)> builtin_domains[] = {
+	{ builtin_domain<zaimoni::_type_spec::_Z_>, is_builtin_domain<zaimoni::_type_spec::_Z_> },
+	{ builtin_domain<zaimoni::_type_spec::_Q_>, is_builtin_domain<zaimoni::_type_spec::_Q_> },
+	{ builtin_domain<zaimoni::_type_spec::_R_>, is_builtin_domain<zaimoni::_type_spec::_R_> },
+	{ builtin_domain<zaimoni::_type_spec::_C_>, is_builtin_domain<zaimoni::_type_spec::_C_> },
+	{ builtin_domain<zaimoni::_type_spec::_H_>, is_builtin_domain<zaimoni::_type_spec::_H_> },
+	{ builtin_domain<zaimoni::_type_spec::_O_>, is_builtin_domain<zaimoni::_type_spec::_O_> },
+	{ builtin_domain<zaimoni::_type_spec::_R_SHARP_>, is_builtin_domain<zaimoni::_type_spec::_R_SHARP_> },
+	{ builtin_domain<zaimoni::_type_spec::_C_SHARP_>, is_builtin_domain<zaimoni::_type_spec::_C_SHARP_> },
+	{ builtin_domain<zaimoni::_type_spec::_H_SHARP_>, is_builtin_domain<zaimoni::_type_spec::_H_SHARP_> },
+	{ builtin_domain<zaimoni::_type_spec::_O_SHARP_>, is_builtin_domain<zaimoni::_type_spec::_O_SHARP_> },
+	{ builtin_domain<zaimoni::_type_spec::_S1_>, is_builtin_domain<zaimoni::_type_spec::_S1_> }
+};
+
+// not a built-in domain, so it takes the virtual fallback
+struct positive_reals final : public zaimoni::_type<zaimoni::_type_spec::_R_> {
+	bool is_totally_ordered() const override { return true; }
+private:
+	bool _nonstrictSuperclass(const type* rhs) const override { return nullptr != dynamic_cast<decltype(this)>(rhs); }
+};
+
+static void report_allocations()
+{
+	const auto& stats = zaimoni::node_pool::statistics();
+	INC_INFORM("node allocations: ");
+	INC_INFORM(stats.pool_allocs);
+	INC_INFORM(" pooled in ");
+	INC_INFORM(stats.chunk_allocs);
+	INC_INFORM(" arena chunks, ");
+	INC_INFORM(stats.heap_allocs);
+	INFORM(" from the global heap");
+}
+
 int main(int argc, char* argv[])
 {
+	zaimoni::node_pool::scope arena;	// nodes built while it is open come from its arena; they may outlive it, and the arena is freed with the last of them
 	auto zero = bootstrap_int(0);
 	auto one = bootstrap_int(1);
 	static_assert(std::end(primitive_numeric) - std::begin(primitive_numeric) == std::end(one) - std::begin(one));
@@ -180,6 +229,534 @@ int main(int argc, char* argv[])
 	}
 #endif
 
+	// block-parallel reduction must not depend on the thread count
+	STRING_LITERAL_TO_STDOUT("\nwide sum\n");
+	std::string wide[2];
+	for (unsigned int n = 0; n < 2; ++n) {
+		zaimoni::_n_ary_op::parallel_threads = 1 + 3 * n;
+		stage_sum = analytic_zero;
+		for (size_t k = 0; k < 3 * zaimoni::_n_ary_op::parallel_threshold; ++k) stage_sum.append_term(new zaimoni::var_fp<double>(double(1 + k % 7)));
+		while (stage_sum.self_eval());
+		wide[n] = stage_sum.to_s();
+	}
+	zaimoni::_n_ary_op::parallel_threads = 0;
+	INFORM(wide[0].c_str());
+	if (wide[0] != wide[1]) {
+		STRING_LITERAL_TO_STDOUT("thread count changed the result: ");
+		INFORM(wide[1].c_str());
+		return EXIT_FAILURE;
+	}
+	// as block results do, nodes from a worker's arena outlive it and are freed on this thread
+	const auto worker_chunks_freed = zaimoni::node_pool::statistics().chunk_frees;
+	std::vector<std::unique_ptr<zaimoni::fp_API> > from_worker;
+	std::jthread([&] {
+		zaimoni::node_pool::scope worker_arena;
+		for (int k = 0; k < 4; ++k) from_worker.emplace_back(new zaimoni::var_fp<double>(k));
+	}).join();
+	from_worker.clear();
+	if (worker_chunks_freed == zaimoni::node_pool::statistics().chunk_frees) {
+		STRING_LITERAL_TO_STDOUT("worker arena was not released\n");
+		return EXIT_FAILURE;
+	}
+
+	// floating-point leaves of one type are summed exactly, whatever the cancellation
+	STRING_LITERAL_TO_STDOUT("\nexact sum\n");
+	stage_sum = analytic_zero;
+	for (const double x : { 1e100, 0.5, -1e100, 0x1p-1074, 1.0, -0x1p-1074, 0.25 }) stage_sum.append_term(new zaimoni::var_fp<double>(x));
+	while (stage_sum.self_eval());
+	INFORM(stage_sum.to_s().c_str());
+	if (1 != stage_sum.arity() || 1.75 != static_cast<const zaimoni::var_fp<double>*>(stage_sum.term_c(0)->get_c())->_x) {
+		STRING_LITERAL_TO_STDOUT("exact sum was not exact\n");
+		return EXIT_FAILURE;
+	}
+
+	// pure-rvalue chains steal their operands: no deep copies, and one n-ary node per operator
+	STRING_LITERAL_TO_STDOUT("\nrvalue chains\n");
+	const auto clones = zaimoni::COW<zaimoni::fp_API>::clone_count();
+	auto leaf = [](double x) { return zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type(new zaimoni::var_fp<double>(x)); };
+	auto chain_sum = leaf(2) + leaf(3) + leaf(5) + -leaf(7);
+	auto chain_product = leaf(2) * leaf(3) * pow(leaf(5), leaf(2)) * (leaf(1) / leaf(7));
+	chain_sum += leaf(11);
+	chain_product *= leaf(13);
+	INFORM(chain_sum.get_c()->to_s().c_str());
+	INFORM(chain_product.get_c()->to_s().c_str());
+	if (clones != zaimoni::COW<zaimoni::fp_API>::clone_count()) {
+		STRING_LITERAL_TO_STDOUT("rvalue chain cloned its operands\n");
+		return EXIT_FAILURE;
+	}
+	if (5 != chain_sum.get_c()->arity() || 5 != chain_product.get_c()->arity()) {
+		STRING_LITERAL_TO_STDOUT("rvalue chain did not flatten\n");
+		return EXIT_FAILURE;
+	}
+
+	// time-sliced evaluation reaches the same result as evaluating to completion
+	STRING_LITERAL_TO_STDOUT("\nsliced evaluation\n");
+	auto unsliced = leaf(1) / (leaf(3) + leaf(5)) + leaf(2) * leaf(7);
+	zaimoni::fp_evaluator sliced(unsliced);
+	while (zaimoni::fp_API::eval(unsliced));
+	size_t slices = 0;
+	while (zaimoni::fp_evaluator::status::suspended == sliced.run_for(std::chrono::nanoseconds(0))) ++slices;
+	INFORM(sliced.expression().get_c()->to_s().c_str());
+	if (unsliced.get_c()->to_s() != sliced.expression().get_c()->to_s() || slices != sliced.steps() || 2 > slices) {
+		STRING_LITERAL_TO_STDOUT("sliced evaluation diverged\n");
+		return EXIT_FAILURE;
+	}
+
+	// mixed complex/real products multiply through the complex numbers
+	STRING_LITERAL_TO_STDOUT("\ncomplex product\n");
+	auto z = [&](double re, double im) { return zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type(new zaimoni::math::complex(leaf(re), leaf(im))); };
+	auto mixed = z(1, 2) * leaf(3) * z(4, 5) * leaf(2) * z(0.5, 1);
+	while (zaimoni::fp_API::eval(mixed));
+	INFORM(mixed.get_c()->to_s().c_str());
+	if ("-96 + 3<i>i</i>" != mixed.get_c()->to_s()) {
+		STRING_LITERAL_TO_STDOUT("complex product was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// intervals across 0 are dearer to multiply, by each other and into complex numbers: group like with like
+	STRING_LITERAL_TO_STDOUT("\nreassociated product\n");
+	auto across_0 = [](double lb, double ub) { return zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type(new zaimoni::var_fp<ISK_INTERVAL<double> >(ISK_INTERVAL<double>(lb, ub))); };
+	zaimoni::product regrouped;
+	regrouped.append_term(z(1, 2));
+	regrouped.append_term(across_0(-1, 2));
+	regrouped.append_term(z(3, 2));
+	regrouped.append_term(across_0(-3, 1));
+	regrouped.self_eval();
+	INFORM(regrouped.to_s().c_str());
+	const bool grouped = 2 == regrouped.arity() && 2 == regrouped.term_c(0)->get_c()->arity() && 2 == regrouped.term_c(1)->get_c()->arity();
+	zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type regrouped_value(regrouped.clone());
+	while (zaimoni::fp_API::eval(regrouped_value));
+	auto tight = z(-1, 8) * across_0(-6, 3);
+	while (zaimoni::fp_API::eval(tight));
+	INFORM(regrouped_value.get_c()->to_s().c_str());
+	if (!grouped || regrouped_value.get_c()->to_s() != tight.get_c()->to_s()) {
+		STRING_LITERAL_TO_STDOUT("product was not reassociated\n");
+		return EXIT_FAILURE;
+	}
+
+	// quotients of integers stay exact, in lowest terms, until there is nothing left to cancel
+	STRING_LITERAL_TO_STDOUT("\ninteger quotients\n");
+	auto n = [](intmax_t x) { return zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type(new zaimoni::var_fp<intmax_t>(x)); };
+	auto telescope = n(2) / n(1);
+	for (intmax_t k = 2; k <= 20; ++k) telescope *= n(k + 1) / n(k);
+	while (zaimoni::fp_API::eval(telescope));
+	INFORM(telescope.get_c()->to_s().c_str());
+	auto signs = n(6) / n(-8);
+	zaimoni::fp_API::eval(signs);
+	INFORM(signs.get_c()->to_s().c_str());
+	auto cancel = (n(6) / n(4)) * (n(10) / n(6));
+	while (zaimoni::fp_API::eval(cancel));
+	INFORM(cancel.get_c()->to_s().c_str());
+	if ("21" != telescope.get_c()->to_s() || "-3/4" != signs.get_c()->to_s() || "2.5" != cancel.get_c()->to_s()) {
+		STRING_LITERAL_TO_STDOUT("integer quotient was not reduced exactly\n");
+		return EXIT_FAILURE;
+	}
+
+	// integer powers evaluate by squaring; a repeated base and exponent comes from the power cache
+	STRING_LITERAL_TO_STDOUT("\ninteger powers\n");
+	auto odd = pow(n(-3), n(5));
+	while (zaimoni::fp_API::eval(odd));
+	INFORM(odd.get_c()->to_s().c_str());
+	const auto cache_hits = zaimoni::power_fp::cache_statistics().hits;
+	auto inverse_cube = pow(leaf(2), n(-3));
+	while (zaimoni::fp_API::eval(inverse_cube));
+	auto inverse_cube2 = pow(leaf(2), n(-3));
+	while (zaimoni::fp_API::eval(inverse_cube2));
+	INFORM(inverse_cube2.get_c()->to_s().c_str());
+	const auto chunks_freed = zaimoni::node_pool::statistics().chunk_frees;
+	const auto cache_lookups = zaimoni::power_fp::cache_statistics().lookups;
+	{
+	zaimoni::node_pool::scope transient;
+	auto fifth = pow(leaf(3), n(5));
+	while (zaimoni::fp_API::eval(fifth));
+	}	// the cached copy must not keep this arena alive
+	if ("-243" != odd.get_c()->to_s() || "0.125" != inverse_cube2.get_c()->to_s() || cache_hits + 1 != zaimoni::power_fp::cache_statistics().hits
+		|| cache_lookups == zaimoni::power_fp::cache_statistics().lookups || chunks_freed == zaimoni::node_pool::statistics().chunk_frees) {
+		STRING_LITERAL_TO_STDOUT("integer power was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// scaling a sum moves its block exponent, not its terms; later terms enter in its units
+	STRING_LITERAL_TO_STDOUT("\nblock exponent\n");
+	stage_sum = analytic_zero;
+	stage_sum.append_term(leaf(3));
+	stage_sum.append_term(leaf(5));
+	stage_sum.scal_bn(40);
+	stage_sum.append_term(leaf(0x1p40));
+	INFORM(stage_sum.to_s().c_str());
+	const auto untouched = static_cast<const zaimoni::var_fp<double>*>(stage_sum.term_c(0)->get_c())->_x;
+	auto scaled = zaimoni::fp_serial::decode(zaimoni::fp_serial::encode(stage_sum));
+	while (zaimoni::fp_API::eval(scaled));
+	INFORM(scaled.get_c()->to_s().c_str());
+	const auto scaled_leaf = dynamic_cast<const zaimoni::var_fp<double>*>(scaled.get_c());
+	if (40 != stage_sum.block_exponent() || 3 != untouched || !scaled_leaf || 0x1p40 * 9 != scaled_leaf->_x) {
+		STRING_LITERAL_TO_STDOUT("block exponent was wrong\n");
+		return EXIT_FAILURE;
+	}
+	zaimoni::sum integer_sum;
+	integer_sum.append_term(n(3));
+	integer_sum.append_term(n(6));
+	const auto& Z = zaimoni::math::get<zaimoni::_type<zaimoni::_type_spec::_Z_> >();
+	const bool was_integer = &Z == integer_sum.domain();
+	integer_sum.scal_bn(-4);	// 9/16
+	INFORM(integer_sum.to_s().c_str());
+	if (!was_integer || &Z == integer_sum.domain() || std::partial_ordering::greater != integer_sum.domain()->subclass(Z)) {
+		STRING_LITERAL_TO_STDOUT("block exponent domain was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// serialization round-trips, shared subtrees included; the memo file answers a warm start without evaluating
+	STRING_LITERAL_TO_STDOUT("\nserialization\n");
+	auto three = leaf(3);
+	three.share();
+	auto stored = leaf(1) / (three + leaf(5)) + leaf(2) * pow(three, leaf(2)) + -leaf(0.25);
+	const auto bytes = zaimoni::fp_serial::encode(*stored.get_c());
+	const auto loaded = zaimoni::fp_serial::decode(bytes);
+	INFORM(loaded.get_c()->to_s().c_str());
+	if (stored.get_c()->to_s() != loaded.get_c()->to_s() || bytes != zaimoni::fp_serial::encode(*loaded.get_c())) {
+		STRING_LITERAL_TO_STDOUT("serialization did not round-trip\n");
+		return EXIT_FAILURE;
+	}
+	const auto memo_path = std::filesystem::temp_directory_path() / "arithmetic.test.memo";
+	std::filesystem::remove(memo_path);
+	auto cold = stored;
+	{
+	zaimoni::fp_memo_file memo(memo_path);
+	memo.eval(cold);
+	if (!memo.save()) {
+		STRING_LITERAL_TO_STDOUT("memo file not saved\n");
+		return EXIT_FAILURE;
+	}
+	}
+	auto warm = stored;
+	zaimoni::fp_memo_file memo(memo_path);
+	memo.eval(warm);
+	std::filesystem::remove(memo_path);
+	INFORM(warm.get_c()->to_s().c_str());
+	if (1 != memo.statistics().hits || cold.get_c()->to_s() != warm.get_c()->to_s()) {
+		STRING_LITERAL_TO_STDOUT("memo file missed\n");
+		return EXIT_FAILURE;
+	}
+
+	// a batch evaluated on a thread pool agrees with evaluating it in turn, subtrees shared across the batch included
+	STRING_LITERAL_TO_STDOUT("\nconcurrent evaluation\n");
+	auto common = leaf(1) / leaf(4) + leaf(2);
+	common.share();
+	std::vector<zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type> batch;
+	for (intmax_t k = 1; k <= 32; ++k) {
+		batch.push_back(common * leaf(k) + leaf(k) / leaf(8) + -leaf(0.25 * k));
+		batch.push_back(n(k) / n(k + 2) * pow(n(-2), n(k % 7)));
+	}
+	auto in_turn = batch;
+	for (decltype(auto) x : in_turn) {
+		while (zaimoni::fp_API::eval(x));
+	}
+	{
+	zaimoni::fp_batch_evaluator pool(4);
+	pool.eval(batch);
+	}
+	INFORM(batch.back().get_c()->to_s().c_str());
+	for (size_t i = 0; i < batch.size(); ++i) {
+		if (batch[i].get_c()->to_s() != in_turn[i].get_c()->to_s()) {
+			STRING_LITERAL_TO_STDOUT("concurrent evaluation diverged\n");
+			return EXIT_FAILURE;
+		}
+	}
+	const zaimoni::sum::rule_guard never = [](const zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type&) { return std::any(); };
+	const zaimoni::sum::would_eval no = [](const std::any&, const std::any&) { return false; };
+	const zaimoni::sum::rule_eval nothing = [](const zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type&, const zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type&) -> zaimoni::fp_API* { return nullptr; };
+	bool refused = false;
+	try {
+		zaimoni::sum::eval_algebraic_rule(zaimoni::sum::eval_rule_spec({ never, never }, { no, nothing }));
+	} catch (const std::logic_error&) {
+		refused = true;
+	}
+	if (!zaimoni::sum::rules_frozen() || !refused) {
+		STRING_LITERAL_TO_STDOUT("rule registry was not frozen\n");
+		return EXIT_FAILURE;
+	}
+
+	// the domain lattice agrees with the class hierarchy; other domains still get answers
+	STRING_LITERAL_TO_STDOUT("\ndomain lattice\n");
+	for (const auto& lhs : builtin_domains) {
+		for (const auto& rhs : builtin_domains) {
+			const auto l = lhs.first();
+			const auto r = rhs.first();
+			const bool l_in_r = rhs.second(l);
+			const bool r_in_l = lhs.second(r);
+			const auto expected = l_in_r ? (r_in_l ? std::partial_ordering::equivalent : std::partial_ordering::less) : (r_in_l ? std::partial_ordering::greater : std::partial_ordering::unordered);
+			if (expected != l->subclass(*r)) {
+				STRING_LITERAL_TO_STDOUT("domain lattice disagrees with the class hierarchy\n");
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	const positive_reals positive;
+	const auto& reals = zaimoni::math::get<zaimoni::_type<zaimoni::_type_spec::_R_> >();
+	const auto& integers = zaimoni::math::get<zaimoni::_type<zaimoni::_type_spec::_Z_> >();
+	const auto& circle = zaimoni::math::get<zaimoni::_type<zaimoni::_type_spec::_S1_> >();
+	if (std::partial_ordering::less != positive.subclass(reals) || &reals != zaimoni::math::type::defined(positive, zaimoni::_type_spec::Addition, reals)
+		|| &integers != zaimoni::math::type::defined(integers, zaimoni::_type_spec::Multiplication, integers)
+		|| &circle != zaimoni::math::type::defined(integers, zaimoni::_type_spec::Multiplication, circle)
+		|| zaimoni::math::type::defined(reals, zaimoni::_type_spec::Addition, circle)) {
+		STRING_LITERAL_TO_STDOUT("domain lattice was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// whole-node properties are cached, and follow the node as it changes
+	STRING_LITERAL_TO_STDOUT("\ncached properties\n");
+	zaimoni::sum tall;
+	for (intmax_t k = 1; k <= 100; ++k) tall.append_term(leaf(k));
+	const bool was_positive = 1 == tall.sgn() && 1 == tall.sgn();
+	tall.append_term(leaf(-1000));
+	bool indeterminate = false;
+	try {
+		tall.sgn();
+	} catch (const std::runtime_error&) {
+		indeterminate = true;
+	}
+	zaimoni::product factors;
+	factors.append_term(leaf(3));
+	factors.append_term(leaf(5));
+	const auto ideal = factors.ideal_scal_bn();
+	const bool was_finite = factors.is_finite();
+	factors.scal_bn(4);
+	const bool rescaled = factors.ideal_scal_bn() == ideal - 4;
+	*factors.term(0) = leaf(-3);
+	if (!was_positive || !indeterminate || !was_finite || !rescaled || -1 != factors.sgn()) {
+		STRING_LITERAL_TO_STDOUT("cached properties were stale\n");
+		return EXIT_FAILURE;
+	}
+
+	// bottom-up rewriting reaches the fixed point evaluating from the root does, and leaves shared subtrees alone
+	STRING_LITERAL_TO_STDOUT("\nworklist rewriting\n");
+	const auto common_was = common.get_c()->to_s();
+	auto nested = leaf(1) / leaf(4) + leaf(2);
+	for (intmax_t k = 1; k <= 12; ++k) nested = (nested + leaf(k) / leaf(8)) * leaf(2) + -leaf(0.5 * k) + common;
+	auto from_root = nested;
+	size_t root_steps = 0;
+	while (zaimoni::fp_API::eval(from_root)) ++root_steps;
+	zaimoni::fp_rewriter bottom_up;
+	const bool rewrote = bottom_up.eval(nested);
+	const auto bottom_up_stats = bottom_up.statistics();
+	INFORM(nested.get_c()->to_s().c_str());
+	INC_INFORM(bottom_up_stats.rewrites);
+	INC_INFORM(" rewrites in ");
+	INC_INFORM(bottom_up_stats.visits);
+	INC_INFORM(" visits; from the root, ");
+	INFORM(root_steps);
+	if (!rewrote || 12 > bottom_up_stats.visits || root_steps < bottom_up_stats.rewrites || nested.get_c()->to_s() != from_root.get_c()->to_s() || bottom_up.eval(nested) || common.get_c()->to_s() != common_was) {
+		STRING_LITERAL_TO_STDOUT("worklist rewriting diverged\n");
+		return EXIT_FAILURE;
+	}
+	// a rewrite deep in the tree reaches the cached structural hash of every ancestor
+	auto rehashed = leaf(2) * pow(leaf(1) + leaf(2), leaf(2)) + -leaf(0.125);
+	const auto hash_was = rehashed.get_c()->structural_hash();
+	const bool deep_rewrite = bottom_up.eval(rehashed);
+	const auto rebuilt = zaimoni::fp_serial::decode(zaimoni::fp_serial::encode(*rehashed.get_c()));
+	INFORM(rehashed.get_c()->to_s().c_str());
+	if (!deep_rewrite || hash_was == rehashed.get_c()->structural_hash() || !rebuilt.get_c()->structural_equal(*rehashed.get_c()) || rebuilt.get_c()->structural_hash() != rehashed.get_c()->structural_hash()) {
+		STRING_LITERAL_TO_STDOUT("rewritten tree kept a stale hash\n");
+		return EXIT_FAILURE;
+	}
+
+	// equality saturation: every pairwise combination is kept, and the cheapest form extracted
+	STRING_LITERAL_TO_STDOUT("\ne-graph\n");
+	auto fixed_product = z(1, 2) * leaf(3) * z(1, -2) * leaf(0.5);
+	auto saturated_product = fixed_product;
+	while (zaimoni::fp_API::eval(fixed_product));
+	const bool saturated = zaimoni::fp_egraph::simplify(saturated_product);
+	INFORM(saturated_product.get_c()->to_s().c_str());
+	auto cancelling = pow(n(3), n(5)) * pow(n(3), n(-5)) + n(2);	// the fixed order throws on this one
+	zaimoni::fp_egraph graph;
+	const auto cancelling_id = graph.add(cancelling);
+	const auto original_cost = graph.cost_of(cancelling_id);
+	const bool converged = graph.saturate();
+	const auto cancelled = graph.extract(cancelling_id);
+	const auto cancelled_cost = graph.cost_of(cancelling_id);
+	INFORM(cancelled.get_c()->to_s().c_str());
+	if (!saturated || saturated_product.get_c()->to_s() != fixed_product.get_c()->to_s() || !converged || 0 != cancelled_cost.mults || !(cancelled_cost < original_cost) || graph.classes() >= graph.size()) {
+		STRING_LITERAL_TO_STDOUT("e-graph extraction was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// adaptive precision: float intervals first, escalating only when they are too wide
+	STRING_LITERAL_TO_STDOUT("\nprecision ladder\n");
+	const auto budgeted = leaf(1) / leaf(3) + leaf(0.1) * leaf(7);
+	const auto coarse = zaimoni::math::eval_to_tolerance(budgeted, 1e-5);
+	const auto fine = zaimoni::math::eval_to_tolerance(budgeted, 1e-12);
+	INFORM(coarse.get_c()->to_s().c_str());
+	INFORM(fine.get_c()->to_s().c_str());
+	const auto coarse_leaf = dynamic_cast<const zaimoni::var_fp<ISK_INTERVAL<float> >*>(coarse.get_c());
+	const auto fine_leaf = dynamic_cast<const zaimoni::var_fp<ISK_INTERVAL<double> >*>(fine.get_c());
+	if (!coarse_leaf || !fine_leaf || 1e-5 < coarse_leaf->_x.width() || 1e-12 < fine_leaf->_x.width() || !ISK_INTERVAL<double>(coarse_leaf->_x).contains(fine_leaf->_x)) {
+		STRING_LITERAL_TO_STDOUT("precision ladder was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// structurally equal trees intern to one node; simplifying it again is answered by the memo
+	STRING_LITERAL_TO_STDOUT("\ninterning\n");
+	auto left = leaf(1) / (leaf(3) + leaf(5)) + leaf(2);
+	auto right = leaf(1) / (leaf(3) + leaf(5)) + leaf(2);
+	auto uninterned = left;
+	zaimoni::fp_intern::intern(left);
+	zaimoni::fp_intern::intern(right);
+	const bool interned = left.get_c() == right.get_c() && zaimoni::fp_intern::is_interned(left.get_c());
+	const auto memo_hits = zaimoni::fp_intern::statistics().eval_hits;
+	while (zaimoni::fp_API::eval(uninterned));
+	const bool simplified = zaimoni::fp_intern::eval(left);
+	const bool remembered = zaimoni::fp_intern::eval(right);
+	INFORM(right.get_c()->to_s().c_str());
+	const bool memoized = memo_hits + 1 == zaimoni::fp_intern::statistics().eval_hits && left.get_c() == right.get_c();
+	zaimoni::fp_intern::clear();
+	if (!interned || !simplified || !remembered || !memoized || uninterned.get_c()->to_s() != right.get_c()->to_s()) {
+		STRING_LITERAL_TO_STDOUT("interning was wrong\n");
+		return EXIT_FAILURE;
+	}
+	// -0.0 is not 0.0, and a NaN leaf is itself
+	auto positive_zero = pow(leaf(0.0), leaf(3));
+	auto negative_zero = pow(leaf(-0.0), leaf(3));
+	auto nan_lhs = pow(leaf(std::numeric_limits<double>::quiet_NaN()), leaf(3));
+	auto nan_rhs = pow(leaf(std::numeric_limits<double>::quiet_NaN()), leaf(3));
+	for (decltype(auto) x : { &positive_zero, &negative_zero, &nan_lhs, &nan_rhs }) zaimoni::fp_intern::intern(*x);
+	const auto signed_zero = dynamic_cast<const zaimoni::var_fp<double>*>(negative_zero.get_c()->term_c(0)->get_c());
+	const bool signed_zero_kept = positive_zero.get_c() != negative_zero.get_c() && signed_zero && std::signbit(signed_zero->_x);
+	const bool nan_shared = nan_lhs.get_c() == nan_rhs.get_c();
+	zaimoni::fp_intern::clear();
+	if (!signed_zero_kept || !nan_shared) {
+		STRING_LITERAL_TO_STDOUT("interning confused signed zeros or NaNs\n");
+		return EXIT_FAILURE;
+	}
+
+	// a compiled tape re-evaluates at new inputs; a shared leaf is one input, however often it appears
+	STRING_LITERAL_TO_STDOUT("\ncompiled tape\n");
+	auto t = leaf(0.5);
+	t.share();	// so the expression refers to this leaf, rather than copies of it
+	const auto polynomial = pow(t, n(3)) + pow(t, n(2)) + leaf(-2) * t + leaf(3) / (t + leaf(1));
+	zaimoni::fp_tape tape(*polynomial.get_c(), { t.get_c() });
+	const auto at_half = tape.eval();	// as compiled
+	tape.bind(0, 2.0);
+	const auto at_two = tape.eval();
+	INFORM(zaimoni::to_string(at_two).c_str());
+	if (1 != tape.inputs() || !at_half.contains(1.375) || 1e-12 < at_half.width() || !at_two.contains(9.0) || 1e-12 < at_two.width()) {
+		STRING_LITERAL_TO_STDOUT("compiled tape was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// batched evaluation agrees with the scalar tape, lane by lane
+	STRING_LITERAL_TO_STDOUT("\nbatched tape\n");
+	zaimoni::fp_tape_batch lanes(tape, 8);
+	for (int i = 0; i < 8; ++i) lanes.bind(0, i, zaimoni::fp_tape::value_type(i / 4.0 - 0.75));
+	lanes.eval();
+	INFORM(zaimoni::to_string(lanes.result(7)).c_str());
+	for (int i = 0; i < 8; ++i) {
+		tape.bind(0, zaimoni::fp_tape::value_type(i / 4.0 - 0.75));
+		const auto scalar = tape.eval();
+		const auto batched = lanes.result(i);
+		if (scalar.lower() != batched.lower() || scalar.upper() != batched.upper()) {
+			STRING_LITERAL_TO_STDOUT("batched tape disagrees\n");
+			return EXIT_FAILURE;
+		}
+	}
+	auto u = leaf(0.5);
+	u.share();
+	const auto powers = pow(u, n(4)) + pow(u, n(5));
+	zaimoni::fp_tape power_tape(*powers.get_c(), { u.get_c() });
+	zaimoni::fp_tape_batch power_lanes(power_tape, 4);
+	for (int i = 0; i < 4; ++i) power_lanes.bind(0, i, zaimoni::fp_tape::value_type(i / 2.0 - 1.5, i / 4.0 - 0.25));	// across 0, and not
+	power_lanes.eval();
+	INFORM(zaimoni::to_string(power_lanes.result(0)).c_str());
+	for (int i = 0; i < 4; ++i) {	// the lanes take each power of the bounds, so they can be tighter than squaring
+		const double lb = i / 2.0 - 1.5;
+		const double ub = i / 4.0 - 0.25;
+		power_tape.bind(0, zaimoni::fp_tape::value_type(lb, ub));
+		const auto scalar = power_tape.eval();
+		const auto batched = power_lanes.result(i);
+		if (!scalar.contains(batched) || !batched.contains(lb * lb * lb * lb * (1 + lb)) || !batched.contains(ub * ub * ub * ub * (1 + ub))) {	// exact
+			STRING_LITERAL_TO_STDOUT("batched powers were wrong\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	// forward-mode derivatives; interval Newton encloses a root, and rejects an interval without one
+	STRING_LITERAL_TO_STDOUT("\ntape derivatives\n");
+	tape.bind(0, 2.0);
+	const auto slope = tape.eval_tangent(0).second;	// 3t^2 + 2t - 2 - 3/(t+1)^2
+	INFORM(zaimoni::to_string(slope).c_str());
+	auto s = leaf(1.5);
+	s.share();
+	const auto two_less = pow(s, n(2)) + leaf(-2);
+	zaimoni::fp_tape root_finder(*two_less.get_c(), { s.get_c() });
+	const auto root = root_finder.newton(0, zaimoni::fp_tape::value_type(1.0, 2.0), 1e-12);
+	if (root) INFORM(zaimoni::to_string(*root).c_str());
+	if (!slope.contains(41.0 / 3) || 1e-12 < slope.width() || !root || 1e-12 < root->width() || 2.0L < (long double)root->lower() * root->lower() || 2.0L > (long double)root->upper() * root->upper()
+		|| root_finder.newton(0, zaimoni::fp_tape::value_type(-1.0, 1.0))) {
+		STRING_LITERAL_TO_STDOUT("tape derivatives were wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// rule guards run once per term: again only for terms that are new or changed
+	STRING_LITERAL_TO_STDOUT("\nguard memo\n");
+	auto guard_calls = [] {
+		size_t ret = 0;
+		for (const auto& x : zaimoni::sum::algebraic_rule_stats()) ret += x.guard_calls;
+		return ret;
+	};
+	zaimoni::sum guarded;
+	for (intmax_t k = 1; k <= 16; ++k) guarded.append_term(leaf(1.0 / k));
+	const auto calls_before = guard_calls();
+	const bool guarded_changed = guarded.algebraic_self_eval() | guarded.algebraic_self_eval();
+	const auto calls_first = guard_calls();
+	guarded.append_term(leaf(0.125) * leaf(3));
+	guarded.algebraic_self_eval();
+	const auto calls_second = guard_calls();
+	INC_INFORM(calls_first - calls_before);
+	INC_INFORM(" guard calls, then ");
+	INFORM(calls_second - calls_first);
+	if (guarded_changed || 16 != calls_first - calls_before || 1 != calls_second - calls_first) {
+		STRING_LITERAL_TO_STDOUT("rule guards reran on unchanged terms\n");
+		return EXIT_FAILURE;
+	}
+
+	// consecutive fold steps rescore only the slots each one touched
+	STRING_LITERAL_TO_STDOUT("\nwide product\n");
+	zaimoni::product wide_product;
+	for (size_t k = 0; k < 96; ++k) wide_product.append_term(leaf(0 == k % 3 ? 2.0 : (1 == k % 3 ? 3.0 : 0.5)));
+	const auto fold_stats = zaimoni::_n_ary_op::fold_queue::statistics();
+	while (wide_product.self_eval());
+	const size_t checked = zaimoni::_n_ary_op::fold_queue::statistics().checked - fold_stats.checked;
+	const size_t scored = zaimoni::_n_ary_op::fold_queue::statistics().scored - fold_stats.scored;
+	INFORM(wide_product.to_s().c_str());
+	INC_INFORM(checked);
+	INC_INFORM(" slots checked, ");
+	INC_INFORM(scored);
+	INFORM(" pairs scored");
+	// each fold step touches at most 3 slots and scores only its result against the rest; starting over each step
+	// would check about 96^2/2 slots and score about 96^3/6 pairs
+	if (1 != wide_product.arity() || wide_product.to_s() != leaf(1853020188851841.0).get_c()->to_s() || 4 * 96 < checked || 96 * 96 < scored) {	// 3^32
+		STRING_LITERAL_TO_STDOUT("wide product was wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	// rule profiling counts what each sum rule did
+	STRING_LITERAL_TO_STDOUT("\nrule profiling\n");
+	auto interval = [](double x) { return zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type(new zaimoni::var_fp<ISK_INTERVAL<double> >(x)); };
+	zaimoni::sum::reset_rule_stats();
+	auto inverses = leaf(1) / interval(3) + leaf(1) / interval(5);
+	while (zaimoni::fp_API::eval(inverses));
+	INFORM(inverses.get_c()->to_s().c_str());
+	bool profiled = false;
+	for (const auto& x : zaimoni::sum::algebraic_rule_stats()) {
+		if (!x.name || std::string_view("multinv_sum") != x.name) continue;
+		profiled = 2 <= x.guard_hits && x.guard_hits <= x.guard_calls && 1 == x.matches && x.matches <= x.tests && 1 == x.fires;
+	}
+	if (!profiled) {
+		zaimoni::sum::report_rules();
+		STRING_LITERAL_TO_STDOUT("rule profiling counts were wrong\n");
+		return EXIT_FAILURE;
+	}
+
+	report_allocations();
 	return 0;
 }
 
@@ -77,6 +77,14 @@ intmax_t complex::ideal_scal_bn() const {
 	return 0;
 }
 
+const complex::eval_type* complex::term_c(size_t n) const {
+	switch (n) {
+	case 0: return &a;
+	case 1: return &b;
+	default: return nullptr;
+	}
+}
+
 std::string complex::to_s() const {
 	std::string ret_re(a->to_s());
 	std::string ret_im(b->to_s());
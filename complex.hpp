@@ -7,7 +7,7 @@ namespace zaimoni {
 namespace math {
 
 // Cartesian coordinate representation.
-class complex final : public fp_API, public eval_to_ptr<fp_API>, API_sum<fp_API>, API_addinv, API_product<fp_API>, API_productinv<fp_API> {
+class complex final : public fp_API, public eval_to_ptr<fp_API>, public API_sum<fp_API>, public API_addinv, public API_product<fp_API>, public API_productinv<fp_API> {
 	eval_type a;
 	eval_type b;
 
@@ -33,7 +33,7 @@ public:
 	bool self_eval() override;
 
 	const math::type* domain() const override {
-		if (is_finite()) return &get<_type<_type_spec::_C_> >();
+		if (const auto test = _is_finite(); test && *test) return &get<_type<_type_spec::_C_> >();	// is_finite() would ask domain()
 		return &get<_type<_type_spec::_C_SHARP_> >();
 	}
 
@@ -50,6 +50,9 @@ public:
 	std::string to_s() const override;
 	int precedence() const override { return std::numeric_limits<int>::max(); }	// numerals outrank all operators
 	int precedence_to_s() const override { return _type_spec::Addition; }
+	size_t arity() const override { return 2; }
+	const eval_type* term_c(size_t n) const override;
+	eval_type* term(size_t n) override { return const_cast<eval_type*>(const_cast<const complex*>(this)->term_c(n)); }
 
 	int rearrange_sum(eval_type& rhs) override;
 	fp_API* eval_sum(const eval_to_ptr<fp_API>::eval_type& rhs) const override;
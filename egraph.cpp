@@ -0,0 +1,336 @@
+#include "egraph.hpp"
+#include "arithmetic.hpp"
+#include "sum.hpp"
+#include "product.hpp"
+#include "quotient.hpp"
+#include "power_fp.hpp"
+#include "Zaimoni.STL/var.hpp"
+#include <bit>
+#include <typeinfo>
+#include <utility>
+
+namespace zaimoni {
+
+static constexpr const size_t pairwise_limit = 8;	// wider sums and products are left to the fixed order
+
+static void add_cost(fp_egraph::cost& dest, const fp_egraph::cost& src)
+{
+	clamped_sum_assign(dest.adds, src.adds);
+	clamped_sum_assign(dest.mults, src.mults);
+	dest.intervals += src.intervals;
+	dest.nodes += src.nodes;
+}
+
+fp_egraph::id fp_egraph::add(COW<fp_API> src)
+{
+	if (!src) throw std::logic_error("fp_egraph::add: null expression");
+	const auto ret = _add(src);
+	_rebuild();
+	return ret;
+}
+
+fp_egraph::id fp_egraph::find(id x)
+{
+	while (_parent[x] != x) {
+		_parent[x] = _parent[_parent[x]];	// path halving
+		x = _parent[x];
+	}
+	return x;
+}
+
+bool fp_egraph::merge(id lhs, id rhs)
+{
+	lhs = find(lhs);
+	rhs = find(rhs);
+	if (lhs == rhs) return false;
+	if (rhs < lhs) std::swap(lhs, rhs);	// the older class names the result
+	_parent[rhs] = lhs;
+	_dirty = true;
+	return true;
+}
+
+bool fp_egraph::saturate(size_t max_iterations)
+{
+	_rebuild();
+	while (_explored < _nodes.size()) {
+		if (0 == max_iterations--) return false;
+		const size_t ub = _nodes.size();	// nodes found this round wait for the next
+		while (_explored < ub) {
+			if (_max_nodes <= _nodes.size()) return false;
+			_explore(_explored++);
+		}
+		_rebuild();
+	}
+	return true;
+}
+
+COW<fp_API> fp_egraph::extract(id x)
+{
+	std::vector<cost> best_cost;
+	std::vector<id> best;
+	_costs(best_cost, best);
+
+	std::unordered_map<id, COW<fp_API> > built;
+	auto build = [&](auto& self, id cls) -> COW<fp_API> {
+		cls = find(cls);
+		if (const auto test = built.find(cls); built.end() != test) return test->second;
+		const auto& node = _nodes[best[cls]];
+		COW<fp_API> ret(node.op);
+		if (const size_t ub = node.terms.size()) {
+			std::vector<COW<fp_API> > terms;
+			terms.reserve(ub);
+			for (const auto t : node.terms) terms.push_back(self(self, t));
+			const auto src = node.op.get_c();
+			bool same = true;
+			for (size_t i = 0; same && i < ub; ++i) same = terms[i].get_c() == src->term_c(i)->get_c();
+			if (!same) {
+				auto dest = ret.get();	// clones
+				if (dest->arity() == ub) {	// else the prototype's own terms stand
+					for (size_t i = 0; i < ub; ++i) *dest->term(i) = std::move(terms[i]);
+				}
+			}
+		}
+		ret.share();
+		return built.try_emplace(cls, ret).first->second;
+	};
+	return build(build, x);
+}
+
+fp_egraph::cost fp_egraph::cost_of(id x)
+{
+	std::vector<cost> best_cost;
+	std::vector<id> best;
+	_costs(best_cost, best);
+	return best_cost[find(x)];
+}
+
+size_t fp_egraph::classes() const
+{
+	size_t ret = 0;
+	for (size_t i = 0; i < _parent.size(); ++i) {
+		if (_parent[i] == i) ++ret;
+	}
+	return ret;
+}
+
+bool fp_egraph::simplify(COW<fp_API>& x, size_t max_nodes)
+{
+	if (!x) return false;
+	fp_egraph graph(max_nodes);
+	const auto root = graph.add(x);
+	graph.saturate();
+	auto result = graph.extract(root);
+	if (result.get_c() == x.get_c()) return false;
+	x = std::move(result);
+	return true;
+}
+
+// terms first, so that they are shared before we are
+fp_egraph::id fp_egraph::_add(COW<fp_API>& x)
+{
+	if (const auto test = _seen.find(x.get_c()); _seen.end() != test) return find(test->second);
+	std::vector<id> terms;
+	if (x.get_c()->arity()) {
+		auto dest = x.get();	// clones if shared; clone may have a different arity
+		const size_t ub = dest->arity();
+		terms.reserve(ub);
+		for (size_t i = 0; i < ub; ++i) terms.push_back(_add(*dest->term(i)));
+	}
+	x.share();
+	return _insert(x, std::move(terms));
+}
+
+fp_egraph::id fp_egraph::_insert(COW<fp_API>& x, std::vector<id>&& terms)
+{
+	for (decltype(auto) t : terms) t = find(t);
+	enode stage{ x, std::move(terms) };
+	const size_t h = _hash(stage);
+	const auto range = _memo.equal_range(h);
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		if (_same(_nodes[iter->second], stage)) return find(iter->second);
+	}
+	const id ret = _nodes.size();
+	_seen.emplace(x.get_c(), ret);
+	_nodes.push_back(std::move(stage));
+	_parent.push_back(ret);
+	_memo.emplace(h, ret);
+	return ret;
+}
+
+size_t fp_egraph::_hash(const enode& x)
+{
+	const auto src = x.op.get_c();
+	size_t ret = hash_combine(typeid(*src).hash_code(), src->node_hash());
+	for (const auto t : x.terms) ret = hash_combine(ret, std::hash<id>()(find(t)));
+	return ret;
+}
+
+bool fp_egraph::_same(const enode& lhs, const enode& rhs)
+{
+	const auto l = lhs.op.get_c();
+	const auto r = rhs.op.get_c();
+	if (typeid(*l) != typeid(*r)) return false;
+	const size_t ub = lhs.terms.size();
+	if (ub != rhs.terms.size() || !l->node_equal(*r)) return false;
+	for (size_t i = 0; i < ub; ++i) {
+		if (find(lhs.terms[i]) != find(rhs.terms[i])) return false;
+	}
+	return true;
+}
+
+// congruence closure: nodes whose terms are now in the same classes are the same
+void fp_egraph::_rebuild()
+{
+	while (_dirty) {
+		_dirty = false;
+		_memo.clear();
+		for (id n = 0; n < _nodes.size(); ++n) {
+			const size_t h = _hash(_nodes[n]);
+			const auto range = _memo.equal_range(h);
+			bool seen = false;
+			for (auto iter = range.first; iter != range.second; ++iter) {
+				if (_same(_nodes[iter->second], _nodes[n])) {
+					merge(iter->second, n);
+					seen = true;
+					break;
+				}
+			}
+			if (!seen) _memo.emplace(h, n);
+		}
+	}
+}
+
+void fp_egraph::_explore(id n)
+{
+	const auto proto = _nodes[n].op;	// _nodes may reallocate
+	const auto src = proto.get_c();
+	// the fixed order, to its fixed point: its steps need not change the structure (evaluation heuristics are state
+	// the nodes keep), so it cannot be taken a step at a time
+	try {
+		auto stage = proto;
+		bool changed = false;
+		while (fp_API::eval(stage)) changed = true;
+		if (changed) merge(n, _add(stage));
+	} catch (const std::logic_error&) {	// no backend for these operands: not a rewrite we can use
+	}
+
+	// the orders it would not have tried
+	const size_t ub = src->arity();
+	if (2 > ub || pairwise_limit < ub) return;
+	const bool is_sum = typeid(*src) == typeid(sum);
+	if (!is_sum && typeid(*src) != typeid(product)) return;
+	if (is_sum) {
+		static const sum unscaled;
+		if (!src->node_equal(unscaled)) return;	// block exponent: not ours to rebuild
+	}
+	for (size_t i = 0; i < ub; ++i) {
+		const auto& lhs = *src->term_c(i);
+		if (is_sum && std::numeric_limits<int>::min() == math::sum_score(lhs)) continue;
+		if (!is_sum && std::numeric_limits<int>::min() == math::product_score(lhs)) continue;
+		for (size_t j = i + 1; j < ub; ++j) {
+			const auto& rhs = *src->term_c(j);
+			COW<fp_API> result;
+			try {
+				if (is_sum) {
+					if (std::numeric_limits<int>::min() < math::sum_score(rhs) && std::numeric_limits<int>::min() < math::sum_score(lhs, rhs)) result = math::eval_sum(lhs, rhs);
+				} else if (std::numeric_limits<int>::min() < math::product_score(lhs, rhs)) result = math::eval_product(lhs, rhs);
+			} catch (const std::logic_error&) {
+				continue;
+			}
+			if (!result) continue;
+			COW<fp_API> stage;
+			if (is_sum) {
+				std::unique_ptr<sum> dest(new sum());
+				for (size_t k = 0; k < ub; ++k) if (i != k && j != k) dest->append_term(*src->term_c(k));
+				dest->append_term(std::move(result));
+				stage = std::unique_ptr<fp_API>(dest.release());
+			} else {
+				std::unique_ptr<product> dest(new product());
+				for (size_t k = 0; k < ub; ++k) if (i != k && j != k) dest->append_term(*src->term_c(k));
+				dest->append_term(std::move(result));
+				stage = std::unique_ptr<fp_API>(dest.release());
+			}
+			const auto alternate = _add(stage);
+			merge(n, alternate);
+		}
+	}
+}
+
+// Bellman-Ford style: a class's cost can only fall, and every class has its acyclic original
+void fp_egraph::_costs(std::vector<cost>& best_cost, std::vector<id>& best)
+{
+	_rebuild();
+	constexpr const id none = std::numeric_limits<id>::max();
+	best_cost.assign(_nodes.size(), cost());
+	best.assign(_nodes.size(), none);
+	bool changed;
+	do {
+		changed = false;
+		for (id n = 0; n < _nodes.size(); ++n) {
+			const auto& node = _nodes[n];
+			bool ready = true;
+			for (const auto t : node.terms) {
+				if (none == best[find(t)]) {
+					ready = false;
+					break;
+				}
+			}
+			if (!ready) continue;
+			const auto test = _node_cost(node, best_cost, best);
+			const id cls = find(n);
+			if (none == best[cls] || test < best_cost[cls]) {
+				best_cost[cls] = test;
+				best[cls] = n;
+				changed = true;
+			}
+		}
+	} while (changed);
+}
+
+fp_egraph::cost fp_egraph::_node_cost(const enode& x, const std::vector<cost>& best_cost, const std::vector<id>& best)
+{
+	cost ret;
+	ret.nodes = 1;
+	const auto src = x.op.get_c();
+	const size_t ub = x.terms.size();
+	if (0 == ub) {
+		if (is_interval(src->leaf_tag())) ++ret.intervals;
+		return ret;
+	}
+	for (const auto t : x.terms) add_cost(ret, best_cost[find(t)]);
+	auto form = [&](size_t i) -> const COW<fp_API>& { return _nodes[best[find(x.terms[i])]].op; };
+
+	if (typeid(*src) == typeid(sum)) {
+		clamped_sum_assign(ret.adds, int(ub - 1));
+	} else if (typeid(*src) == typeid(product)) {
+		// as the fold would go: complex-like (API_product) factors absorb the others
+		std::pair<int, int> ops(0, 0);
+		size_t rep = 0;
+		for (size_t i = 1; i < ub; ++i) {
+			math::update_op_count_product(form(rep), form(i), ops);
+			if (!dynamic_cast<const API_product<fp_API>*>(form(rep).get_c()) && dynamic_cast<const API_product<fp_API>*>(form(i).get_c())) rep = i;
+		}
+		clamped_sum_assign(ret.adds, ops.first);
+		clamped_sum_assign(ret.mults, ops.second);
+	} else if (typeid(*src) == typeid(quotient) && 2 == ub) {
+		// dividing costs about what multiplying does
+		std::pair<int, int> ops(0, 0);
+		math::update_op_count_product(form(0), form(1), ops);
+		clamped_sum_assign(ret.adds, ops.first);
+		clamped_sum_assign(ret.mults, ops.second);
+	} else if (typeid(*src) == typeid(power_fp) && 2 == ub) {
+		int mults = 1;
+		if (const auto e = form(1).get_c(); fp_leaf::s_int == e->leaf_tag()) {
+			// by squaring; a negative power is one reciprocal more
+			const intmax_t n = static_cast<const var_fp<intmax_t>*>(e)->_x;
+			if (INTMAX_MIN < n && 0 != n) {
+				const uintmax_t abs_n = 0 < n ? n : -n;
+				mults = std::bit_width(abs_n) - 1 + std::popcount(abs_n) - 1 + (0 > n);
+			}
+		}
+		clamped_sum_assign(ret.mults, mults);
+	}
+	return ret;
+}
+
+}	// namespace zaimoni
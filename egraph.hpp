@@ -0,0 +1,90 @@
+#ifndef EGRAPH_HPP
+#define EGRAPH_HPP 1
+
+#include "Zaimoni.STL/eval.hpp"
+#include <compare>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace zaimoni {
+
+// equality saturation for fp_API expression trees.  The existing rewrite rules are applied to copies, so every form
+// they reach is kept; the forms of a class all enclose the same value.  Rules: while (fp_API::eval(x)); on a copy of
+// each node, and every pairwise eval_sum (eval_product) of the terms of a sum (product), not just the pairs the fixed
+// order would try.  The cheapest form is then extracted, by elementary operation count
+// (math::update_op_count_product), so it is never more expensive than what the fixed order reaches.  The graph is only
+// as exact as those rules: a rounding eval_sum (eval_product) result joins its whole class.
+class fp_egraph final
+{
+public:
+	using id = size_t;
+
+	struct cost {
+		int adds = 0;
+		int mults = 0;
+		size_t intervals = 0;	// interval leaves; fewer is tighter
+		size_t nodes = 0;
+
+		friend std::strong_ordering operator<=>(const cost& lhs, const cost& rhs) {
+			if (const auto test = lhs.adds + lhs.mults <=> rhs.adds + rhs.mults; 0 != test) return test;
+			if (const auto test = lhs.mults <=> rhs.mults; 0 != test) return test;
+			if (const auto test = lhs.intervals <=> rhs.intervals; 0 != test) return test;
+			return lhs.nodes <=> rhs.nodes;
+		}
+		friend bool operator==(const cost& lhs, const cost& rhs) = default;
+	};
+
+	static constexpr const size_t default_max_nodes = 4096;
+
+private:
+	struct enode {
+		COW<fp_API> op;	// shared; its own terms are one form of each term class
+		std::vector<id> terms;
+	};
+
+	std::vector<enode> _nodes;
+	std::vector<id> _parent;	// union-find over _nodes; a class is named by its root
+	std::unordered_multimap<size_t, id> _memo;	// hash-consing, by node and term classes
+	std::unordered_map<const fp_API*, id> _seen;	// prototypes already added
+	size_t _explored;	// _nodes before this have had the rules applied
+	size_t _max_nodes;
+	bool _dirty;	// merged since the last _rebuild
+
+public:
+	explicit fp_egraph(size_t max_nodes = default_max_nodes) : _explored(0), _max_nodes(max_nodes), _dirty(false) {}
+	fp_egraph(const fp_egraph& src) = delete;
+	fp_egraph(fp_egraph&& src) = default;
+	~fp_egraph() = default;
+	fp_egraph& operator=(const fp_egraph& src) = delete;
+	fp_egraph& operator=(fp_egraph&& src) = default;
+
+	id add(COW<fp_API> src);	// a non-const lvalue is shared rather than copied
+	id find(id x);
+	bool merge(id lhs, id rhs);	// false if already the same class
+	// true if the rules found nothing more; false if the node budget or max_iterations ran out first.  A rule that
+	// throws std::logic_error (no backend for its operands) is skipped; other exceptions propagate.
+	bool saturate(size_t max_iterations = std::numeric_limits<size_t>::max());
+	COW<fp_API> extract(id x);	// cheapest form of the class; shares subtrees with us
+	cost cost_of(id x);
+
+	size_t size() const { return _nodes.size(); }
+	size_t classes() const;
+
+	// add, saturate and extract.  true if x changed
+	static bool simplify(COW<fp_API>& x, size_t max_nodes = default_max_nodes);
+
+private:
+	id _add(COW<fp_API>& x);
+	id _insert(COW<fp_API>& x, std::vector<id>&& terms);
+	size_t _hash(const enode& x);
+	bool _same(const enode& lhs, const enode& rhs);
+	void _rebuild();
+	void _explore(id n);
+	void _costs(std::vector<cost>& best_cost, std::vector<id>& best);
+	cost _node_cost(const enode& x, const std::vector<cost>& best_cost, const std::vector<id>& best);
+};
+
+}	// namespace zaimoni
+
+#endif
@@ -0,0 +1,178 @@
+#include "evaluator.hpp"
+#include "sum.hpp"
+#include <utility>
+
+namespace zaimoni {
+
+bool fp_evaluator::step()
+{
+	if (_done) return false;
+	if (!_x || !fp_API::eval(_x)) {
+		_done = true;
+		return false;
+	}
+	++_steps;
+	return true;
+}
+
+fp_evaluator::status fp_evaluator::run(size_t max_steps)
+{
+	while (0 < max_steps--) {
+		if (!step()) return status::done;
+	}
+	return _done ? status::done : status::suspended;
+}
+
+fp_evaluator::status fp_evaluator::run_until(clock::time_point deadline, size_t max_steps, std::stop_token stop)
+{
+	if (0 == max_steps) return _done ? status::done : status::suspended;
+	do {
+		if (!step()) return status::done;
+	} while (0 < --max_steps && clock::now() < deadline && !stop.stop_requested());
+	return status::suspended;
+}
+
+bool fp_rewriter::eval(COW<fp_API>& x)
+{
+	_work.clear();
+	_index(&x, nullptr, 0, SIZE_MAX);
+	bool ret = false;
+	while (!_work.empty()) {
+		const auto at = _work.back();
+		_work.pop_back();
+		++_stats.visits;
+		if (!at.owned) {	// shared: evaluated whole
+			if (!fp_API::eval(*at.slot)) continue;
+			++_stats.rewrites;
+			ret = true;
+			_changed(at);
+			_index(at.slot, at.parent, at.index, at.up);	// we own it now
+			continue;
+		}
+		_note_terms(*at.slot->get_c());
+		if (!fp_API::local_eval(*at.slot)) continue;
+		ret = true;
+		do ++_stats.rewrites;
+		while (fp_API::local_eval(*at.slot));
+		_changed(at);
+
+		// at a fixed point for the terms it has; any it made must be evaluated, and then it is looked at again
+		const auto rw = at.slot->get_rw<fp_API>();
+		if (!rw || _seen_before(rw->second)) continue;	// one of its terms took its place
+		if (!rw->first) {
+			_work.push_back(item{ at.slot, at.parent, at.index, at.up, false });
+			continue;
+		}
+		const size_t base = _work.size();
+		_work.push_back(item{ at.slot, at.parent, at.index, at.up, true });
+		const size_t ub = rw->first->arity();
+		for (size_t i = 0; i < ub; ++i) {
+			const auto term = rw->first->term_c(i);
+			if (term && !_seen_before(term->get_c())) _index(const_cast<COW<fp_API>*>(term), rw->first, i, base);
+		}
+		if (base + 1 == _work.size()) _work.pop_back();	// no new terms
+	}
+	return ret;
+}
+
+// parents are queued before their terms, so they are popped after them
+void fp_rewriter::_index(COW<fp_API>* src, fp_API* parent, size_t index, size_t up)
+{
+	_pending.assign(1, item{ src, parent, index, up, false });
+	while (!_pending.empty()) {
+		auto at = _pending.back();
+		_pending.pop_back();
+		if (!*at.slot) continue;
+		const auto rw = at.slot->get_rw<fp_API>();
+		at.owned = rw && rw->first;
+		const size_t queued = _work.size();
+		_work.push_back(at);
+		if (!at.owned) continue;	// shared: wait for a rewrite to clone it
+		const size_t ub = rw->first->arity();
+		for (size_t i = 0; i < ub; ++i) {
+			// not term(): that tells the node it changed, which waits for an actual rewrite
+			if (const auto term = rw->first->term_c(i)) _pending.push_back(item{ const_cast<COW<fp_API>*>(term), rw->first, i, queued, false });
+		}
+	}
+}
+
+// term() on each ancestor: a rewrite changes the structure of all of them
+void fp_rewriter::_changed(const item& src)
+{
+	for (auto at = &src; at->parent; at = &_work[at->up]) at->parent->term(at->index);
+}
+
+void fp_rewriter::_note_terms(const fp_API& src)
+{
+	_seen.clear();
+	const size_t ub = src.arity();
+	for (size_t i = 0; i < ub; ++i) {
+		const auto term = src.term_c(i);
+		if (const auto x = term ? term->get_c() : nullptr) _seen[x] = x->structural_hash();
+	}
+}
+
+// the hash catches terms changed in place, and node pool addresses reused by new terms
+bool fp_rewriter::_seen_before(const fp_API* src) const
+{
+	if (!src) return true;
+	const auto at = _seen.find(src);
+	return _seen.end() != at && at->second == src->structural_hash();
+}
+
+fp_batch_evaluator::fp_batch_evaluator(unsigned threads) : _next(0), _generation(0), _busy(0)
+{
+	sum::freeze_rules();	// registration would race against evaluation
+	if (1 < threads) {
+		_workers.reserve(threads - 1);
+		while (_workers.size() + 1 < threads) _workers.emplace_back([this](std::stop_token stop) { _work(stop); });
+	}
+}
+
+void fp_batch_evaluator::eval(std::span<COW<fp_API> > src)
+{
+	{
+	std::lock_guard lock(_lock);
+	_batch = src;
+	_next = 0;
+	_error = nullptr;
+	++_generation;
+	}
+	_wake.notify_all();
+	_drain(src);
+	std::unique_lock lock(_lock);
+	_idle.wait(lock, [this] { return 0 == _busy; });
+	_batch = {};	// late workers find nothing to do
+	if (_error) std::rethrow_exception(std::exchange(_error, nullptr));
+}
+
+void fp_batch_evaluator::_work(std::stop_token stop)
+{
+	size_t seen = 0;
+	std::unique_lock lock(_lock);
+	while (_wake.wait(lock, stop, [&] { return seen != _generation; })) {
+		seen = _generation;
+		const auto batch = _batch;	// eval() waits for us before replacing it
+		if (batch.empty()) continue;	// woke after the batch finished; claiming would skip part of the next one
+		++_busy;
+		lock.unlock();
+		_drain(batch);
+		lock.lock();
+		if (0 == --_busy) _idle.notify_all();
+	}
+}
+
+void fp_batch_evaluator::_drain(std::span<COW<fp_API> > batch)
+{
+	size_t i;
+	while (batch.size() > (i = _next.fetch_add(1, std::memory_order_relaxed))) {
+		try {
+			while (fp_API::eval(batch[i]));
+		} catch (...) {
+			std::lock_guard lock(_lock);
+			if (!_error) _error = std::current_exception();
+		}
+	}
+}
+
+}	// namespace zaimoni
@@ -0,0 +1,141 @@
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP 1
+
+#include "Zaimoni.STL/eval.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zaimoni {
+
+// while (fp_API::eval(x)); in bounded slices.  Evaluation state lives in the expression itself (n-ary heuristics and
+// so on), so a suspended evaluator resumes where it left off: slices may be spread across frames, or run on a
+// background thread.  One thread at a time; a background thread should not have a node_pool::scope active, as the
+// result outlives it.
+class fp_evaluator final
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	enum class status : unsigned char {
+		done = 0,
+		suspended
+	};
+
+private:
+	COW<fp_API> _x;
+	size_t _steps;	// rewrite steps taken so far
+	bool _done;
+
+public:
+	explicit fp_evaluator(const COW<fp_API>& src) : _x(src), _steps(0), _done(false) {}
+	explicit fp_evaluator(COW<fp_API>&& src) noexcept : _x(std::move(src)), _steps(0), _done(false) {}
+	fp_evaluator(const fp_evaluator& src) = default;
+	fp_evaluator(fp_evaluator&& src) = default;
+	~fp_evaluator() = default;
+	fp_evaluator& operator=(const fp_evaluator& src) = default;
+	fp_evaluator& operator=(fp_evaluator&& src) = default;
+
+	bool step();	// one rewrite step; false once there is nothing left to do
+	status run(size_t max_steps);
+	// at least one step is taken, unless max_steps is zero or we are already done
+	status run_until(clock::time_point deadline, size_t max_steps = std::numeric_limits<size_t>::max(), std::stop_token stop = {});
+	status run_for(clock::duration budget, size_t max_steps = std::numeric_limits<size_t>::max()) { return run_until(clock::now() + budget, max_steps); }
+
+	bool done() const { return _done; }
+	size_t steps() const { return _steps; }
+	const COW<fp_API>& expression() const { return _x; }
+	COW<fp_API> release() { return std::move(_x); }	// the evaluator is empty afterwards
+};
+
+// while (fp_API::eval(x)); bottom up.  Each node is evaluated to a fixed point before its parent is, from a worklist in
+// which every node's ancestors are queued beneath it: after a rewrite, only the node that changed, any terms it made,
+// and then its ancestors are examined again, rather than everything from the root down.  Nodes whose terms are queued
+// are evaluated with fp_API::local_eval, which leaves the terms alone.  A shared node is evaluated whole until a
+// rewrite clones it; only then are its terms queued.  Every ancestor of a rewritten node is told, through term(), so
+// that it drops its cached properties (structural hash included).
+class fp_rewriter final
+{
+public:
+	struct stats {
+		size_t visits = 0;	// worklist entries examined
+		size_t rewrites = 0;
+	};
+
+private:
+	struct item {
+		COW<fp_API>* slot;
+		fp_API* parent;	// nullptr for the root
+		size_t index;	// of slot in parent
+		size_t up;	// _work index of the parent's entry, which is popped after this one
+		bool owned;	// terms are queued
+	};
+
+	std::vector<item> _work;	// popped from the back
+	std::vector<item> _pending;	// scratch for _index
+	std::unordered_map<const fp_API*, size_t> _seen;	// terms of the node being evaluated, with their structural hashes
+	stats _stats;
+
+public:
+	fp_rewriter() = default;
+	fp_rewriter(const fp_rewriter& src) = delete;
+	fp_rewriter(fp_rewriter&& src) = default;
+	~fp_rewriter() = default;
+	fp_rewriter& operator=(const fp_rewriter& src) = delete;
+	fp_rewriter& operator=(fp_rewriter&& src) = default;
+
+	bool eval(COW<fp_API>& x);	// true if anything changed
+	const stats& statistics() const { return _stats; }
+
+private:
+	void _index(COW<fp_API>* src, fp_API* parent, size_t index, size_t up);
+	void _changed(const item& src);
+	void _note_terms(const fp_API& src);
+	bool _seen_before(const fp_API* src) const;
+};
+
+// while (fp_API::eval(x)); for each of a batch of independent expressions, on a pool of threads.  The expressions may
+// share subtrees (shared nodes are cloned before being written to), but each must be its own COW object.  The calling
+// thread works on the batch too, so a pool of one thread has no workers.  Freezes the sum rule registry.
+class fp_batch_evaluator final
+{
+	std::mutex _lock;
+	std::condition_variable_any _wake;	// workers: a new batch
+	std::condition_variable _idle;	// caller: workers have finished
+	std::span<COW<fp_API> > _batch;
+	std::atomic<size_t> _next;	// first unclaimed element of _batch
+	size_t _generation;	// batches started
+	size_t _busy;	// workers in the current batch
+	std::exception_ptr _error;
+	std::vector<std::jthread> _workers;	// last: stopped and joined first
+
+public:
+	explicit fp_batch_evaluator(unsigned threads = std::thread::hardware_concurrency());	// 0: one thread
+	fp_batch_evaluator(const fp_batch_evaluator& src) = delete;
+	fp_batch_evaluator(fp_batch_evaluator&& src) = delete;
+	~fp_batch_evaluator() = default;
+	fp_batch_evaluator& operator=(const fp_batch_evaluator& src) = delete;
+	fp_batch_evaluator& operator=(fp_batch_evaluator&& src) = delete;
+
+	size_t threads() const { return _workers.size() + 1; }
+	// returns once the whole batch is evaluated.  If evaluating an element throws, the rest of the batch is still
+	// evaluated, and then the first exception is rethrown; that element is left partially evaluated.
+	void eval(std::span<COW<fp_API> > src);
+
+private:
+	void _work(std::stop_token stop);
+	void _drain(std::span<COW<fp_API> > batch);
+};
+
+}	// namespace zaimoni
+
+#endif
@@ -37,9 +37,10 @@ public:
 	{
 		if (0 == src) canonical_zero();
 		else {
+			const uintmax_t magnitude = negative ? uintmax_t(-(src + 1)) + 1 : uintmax_t(src);	// src / mantissa_as_int would be unsigned division
 			mantissa_as_int = _mantissa_as_int(src);
 			mantissa_bits = INT_LOG2(mantissa_as_int) + 1;
-			fp_exp = mantissa_bits + INT_LOG2(src / mantissa_as_int);
+			fp_exp = mantissa_bits + INT_LOG2(magnitude / mantissa_as_int);
 		}
 	}
 
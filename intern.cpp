@@ -0,0 +1,154 @@
+#include "intern.hpp"
+#include "Zaimoni.STL/Logging.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace zaimoni {
+
+static std::unordered_multimap<size_t, std::shared_ptr<const fp_API> > _table;
+static std::unordered_map<const fp_API*, size_t> _hash_of;	// doubles as the membership test
+static std::unordered_map<const fp_API*, std::shared_ptr<const fp_API> > _simplified;
+static fp_intern::stats _stats;
+static std::mutex _lock;	// for all of the above; not held while evaluating
+
+// terms are already interned, so they compare by address
+static bool same_node(const fp_API* lhs, const fp_API* rhs)
+{
+	if (typeid(*lhs) != typeid(*rhs)) return false;
+	const size_t ub = lhs->arity();
+	if (ub != rhs->arity()) return false;
+	if (!lhs->node_equal(*rhs)) return false;
+	for (size_t i = 0; i < ub; ++i) {
+		if (lhs->term_c(i)->get_c() != rhs->term_c(i)->get_c()) return false;
+	}
+	return true;
+}
+
+// agrees with fp_API::structural_hash, without recursing
+static size_t node_hash(const fp_API* src)
+{
+	size_t ret = hash_combine(typeid(*src).hash_code(), src->node_hash());
+	const size_t ub = src->arity();
+	for (size_t i = 0; i < ub; ++i) ret = hash_combine(ret, _hash_of.find(src->term_c(i)->get_c())->second);
+	return ret;
+}
+
+static bool is_interned(const fp_API* x) { return _hash_of.contains(x); }
+
+bool fp_intern::is_interned(const fp_API* x)
+{
+	std::lock_guard lock(_lock);
+	return zaimoni::is_interned(x);
+}
+
+// caller holds _lock
+static void intern(COW<fp_API>& x)
+{
+	if (!x) return;
+	++_stats.lookups;
+	if (is_interned(x.get_c())) {
+		++_stats.hits;
+		return;
+	}
+	bool terms_ok = true;
+	{
+	const auto src = x.get_c();
+	const size_t ub = src->arity();
+	for (size_t i = 0; i < ub; ++i) {
+		if (!is_interned(src->term_c(i)->get_c())) {
+			terms_ok = false;
+			break;
+		}
+	}
+	}
+	if (!terms_ok) {
+		auto dest = x.get();	// clones if shared; clone may have a different arity
+		const size_t ub = dest->arity();
+		for (size_t i = 0; i < ub; ++i) intern(*dest->term(i));
+	}
+
+	const auto src = x.get_c();
+	const auto h = node_hash(src);
+	const auto range = _table.equal_range(h);
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		if (same_node(iter->second.get(), src)) {
+			x = iter->second;
+			++_stats.hits;
+			return;
+		}
+	}
+	const auto& stage = x.share();
+	_table.emplace(h, stage);
+	_hash_of[stage.get()] = h;
+}
+
+void fp_intern::intern(COW<fp_API>& x)
+{
+	std::lock_guard lock(_lock);
+	zaimoni::intern(x);
+}
+
+bool fp_intern::eval(COW<fp_API>& x)
+{
+	if (!x) return false;
+	std::unique_lock lock(_lock);
+	zaimoni::intern(x);
+	const auto origin = x.get_c();	// kept alive by x
+	++_stats.eval_lookups;
+	if (const auto test = _simplified.find(origin); _simplified.end() != test) {
+		++_stats.eval_hits;
+		if (origin == test->second.get()) return false;
+		x = test->second;
+		return true;
+	}
+	lock.unlock();
+
+	auto working(x);
+	while (fp_API::eval(working));
+	lock.lock();
+	zaimoni::intern(working);
+	const auto& result = _simplified.try_emplace(origin, working.share()).first->second;	// another thread may have been first
+	_simplified.try_emplace(result.get(), result);	// fixed point
+	if (origin == result.get()) return false;
+	x = result;
+	return true;
+}
+
+size_t fp_intern::size()
+{
+	std::lock_guard lock(_lock);
+	return _table.size();
+}
+
+fp_intern::stats fp_intern::statistics()
+{
+	std::lock_guard lock(_lock);
+	return _stats;
+}
+
+void fp_intern::clear()
+{
+	std::lock_guard lock(_lock);
+	_simplified.clear();
+	_hash_of.clear();
+	_table.clear();
+	_stats = stats();
+}
+
+void fp_intern::report()
+{
+	const auto nodes = size();
+	const auto stats = statistics();
+	INC_INFORM("interned nodes: ");
+	INFORM(nodes);
+	INC_INFORM("intern hits: ");
+	INC_INFORM(stats.hits);
+	INC_INFORM("/");
+	INFORM(stats.lookups);
+	INC_INFORM("simplification hits: ");
+	INC_INFORM(stats.eval_hits);
+	INC_INFORM("/");
+	INFORM(stats.eval_lookups);
+}
+
+}	// namespace zaimoni
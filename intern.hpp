@@ -0,0 +1,41 @@
+#ifndef INTERN_HPP
+#define INTERN_HPP 1
+
+#include "Zaimoni.STL/eval.hpp"
+
+namespace zaimoni {
+
+// hash-consing for fp_API expression trees.  Structurally equal interned subtrees share one read-only node;
+// writes go through COW as usual, so the table itself is never modified by evaluation.  Thread-safe.
+class fp_intern final
+{
+public:
+	struct stats {
+		size_t lookups = 0;	// nodes presented for interning
+		size_t hits = 0;	// ...that were already in the table
+		size_t eval_lookups = 0;
+		size_t eval_hits = 0;	// simplification results reused
+	};
+
+	fp_intern() = delete;
+
+	static void intern(COW<fp_API>& x);	// in-place
+	static COW<fp_API> interned(const COW<fp_API>& x) {
+		auto ret(x);
+		intern(ret);
+		return ret;	// trigger NRVO
+	}
+	static bool is_interned(const fp_API* x);
+
+	// memoized equivalent of while(fp_API::eval(x));
+	static bool eval(COW<fp_API>& x);
+
+	static size_t size();
+	static stats statistics();
+	static void clear();
+	static void report();
+};
+
+}	// namespace zaimoni
+
+#endif
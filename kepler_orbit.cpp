@@ -166,6 +166,9 @@ orbit::eccentric_anomaly orbit::E(const mean_anomaly& M) {
 // fast compile test
 // g++ -std=c++14 -otest.exe -Os  -D__STDC_LIMIT_MACROS -DTEST_APP2 conic.test.cpp constants.cpp -Llib\host.isk -lz_stdio_c -lz_log_adapter -lz_stdio_log -lz_format_util
 #include "arithmetic.hpp"
+#include "intern.hpp"
+#include "evaluator.hpp"
+#include "tape.hpp"
 #include "Zaimoni.STL/var.hpp"
 
 #include "test_driver.h"
@@ -205,8 +208,20 @@ int main(int argc, char* argv[])
 	// reduced mass of n bodies is the harmonic mean of their masses, divided by n .. i.e. the n multipler on top is dropped
 	STRING_LITERAL_TO_STDOUT("example reduced mass (GM)\n");
 	INFORM(reduced_mass->to_s().c_str());
+	zaimoni::fp_evaluator reducing(reduced_mass);	// same reduction, resumably; below
 	while(zaimoni::fp_API::eval(reduced_mass)) INFORM(reduced_mass->to_s().c_str());
 
+	// one rewrite step per slice, as a frame loop would budget it
+	size_t slices = 0;
+	while (zaimoni::fp_evaluator::status::suspended == reducing.run(1)) ++slices;
+	INC_INFORM("sliced reduced mass (GM): ");
+	INC_INFORM(slices);
+	INFORM(" slices");
+	if (reducing.expression()->to_s() != reduced_mass->to_s()) {
+		STRING_LITERAL_TO_STDOUT("sliced evaluation diverged\n");
+		return EXIT_FAILURE;
+	}
+
 	// geometrized Lorentz metric demo
 	zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type one_half(new zaimoni::var_fp<double>(0.5));
 	zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type two(new zaimoni::var_fp<uintmax_t>(2));
@@ -218,6 +233,80 @@ int main(int argc, char* argv[])
 	INFORM(Lorentz->to_s().c_str());
 	while (Lorentz->self_eval()) INFORM(Lorentz->to_s().c_str());
 
+	// hash-consing: the three spatial terms are structurally identical
+	auto Spatial2 = pow(one_half, two);
+	Spatial2 += pow(one_half, two);
+	Spatial2 += pow(one_half, two);
+	auto Lorentz2 = pow(one, two) + -Spatial2;
+	auto Lorentz3 = pow(one, two) + -Spatial2;
+	zaimoni::fp_intern::intern(Lorentz2);
+	zaimoni::fp_intern::intern(Lorentz3);
+	STRING_LITERAL_TO_STDOUT("interned Lorentz metric squared\n");
+	if (Lorentz2.get_c() != Lorentz3.get_c()) {
+		STRING_LITERAL_TO_STDOUT("interning failed\n");
+		return EXIT_FAILURE;
+	}
+	zaimoni::fp_intern::eval(Lorentz2);
+	INFORM(Lorentz2.get_c()->to_s().c_str());
+	if (zaimoni::fp_intern::eval(Lorentz3) && Lorentz2.get_c() != Lorentz3.get_c()) {
+		STRING_LITERAL_TO_STDOUT("simplification memo failed\n");
+		return EXIT_FAILURE;
+	}
+	zaimoni::fp_intern::report();
+	zaimoni::fp_intern::clear();
+
+	// compiled tape: sweep the Lorentz metric over the spatial component
+	zaimoni::eval_to_ptr<zaimoni::fp_API>::eval_type v(new zaimoni::var_fp<double>(0.5));
+	v.share();	// so the expression refers to this leaf, rather than copies of it
+	auto SpatialV = pow(v, two);
+	SpatialV += pow(v, two);
+	SpatialV += pow(v, two);
+	auto LorentzV = pow(one, two) + -SpatialV;
+	zaimoni::fp_tape metric(*LorentzV.get_c(), { v.get_c() });
+	STRING_LITERAL_TO_STDOUT("Lorentz metric squared tape: ");
+	INC_INFORM(metric.size());
+	INFORM(" instructions");
+	for (int i = 0; i <= 4; ++i) {
+		const zaimoni::fp_tape::value_type speed(i / 8.0);
+		INFORM(zaimoni::to_string(metric({ &speed, 1 })).c_str());
+	}
+	// same sweep, one lane per speed
+	zaimoni::fp_tape_batch metrics(metric, 5);
+	for (int i = 0; i <= 4; ++i) metrics.bind(0, i, zaimoni::fp_tape::value_type(i / 8.0));
+	metrics.eval();
+	for (int i = 0; i <= 4; ++i) {
+		const zaimoni::fp_tape::value_type speed(i / 8.0);
+		const auto scalar = metric({ &speed, 1 });
+		const auto batch = metrics.result(i);
+		if (scalar.lower() != batch.lower() || scalar.upper() != batch.upper()) {
+			STRING_LITERAL_TO_STDOUT("batched tape disagrees: ");
+			INFORM(zaimoni::to_string(batch).c_str());
+			return EXIT_FAILURE;
+		}
+	}
+	// forward-mode derivative, then interval Newton for the speed at which the metric vanishes
+	metric.bind(0, zaimoni::fp_tape::value_type(0.5));
+	const auto slope = metric.eval_tangent(0).second;
+	STRING_LITERAL_TO_STDOUT("Lorentz metric squared slope at 0.5: ");
+	INFORM(zaimoni::to_string(slope).c_str());
+	if (-3.0 != slope.lower() || -3.0 != slope.upper()) {
+		STRING_LITERAL_TO_STDOUT("tangent tape wrong\n");
+		return EXIT_FAILURE;
+	}
+	const auto lightlike = metric.newton(0, zaimoni::fp_tape::value_type(0.25, 1.0), 1e-12);
+	if (lightlike) {
+		STRING_LITERAL_TO_STDOUT("lightlike speed: ");
+		INFORM(zaimoni::to_string(*lightlike).c_str());
+	}
+	if (!lightlike || 1e-12 < lightlike->width() || 1.0L < 3.0L * lightlike->lower() * lightlike->lower() || 1.0L > 3.0L * lightlike->upper() * lightlike->upper()) {
+		STRING_LITERAL_TO_STDOUT("interval Newton lost the root\n");
+		return EXIT_FAILURE;
+	}
+	if (metric.newton(0, zaimoni::fp_tape::value_type(0.0, 0.5))) {
+		STRING_LITERAL_TO_STDOUT("interval Newton found a root that is not there\n");
+		return EXIT_FAILURE;
+	}
+
 	// \todo units conversion...put astronomical unit AU somewhere, then use it below
 	conic unit_circle(1);
 	STRING_LITERAL_TO_STDOUT("unit circle\n");
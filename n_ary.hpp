@@ -2,8 +2,15 @@
 #define N_ARY_HPP 1
 
 #include "Zaimoni.STL/eval.hpp"
-#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cfenv>
+#include <exception>
 #include <map>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace zaimoni {
 
@@ -16,11 +23,321 @@ namespace zaimoni {
 			strict_max_core_heuristic
 		};
 
+		// very wide operations are first reduced block-by-block on worker threads.  Blocks are a fixed size, so the result
+		// does not depend on the thread count.
+		static constexpr size_t parallel_block = 1024;
+		static constexpr size_t parallel_threshold = 4 * parallel_block;
+		static inline unsigned int parallel_threads = 0;	// 0: std::thread::hardware_concurrency()
+
 		// bridge support
 		template<class T> static int null_rearrange(T& lhs, T& rhs) { return 0; }
 		template<class T> static int null_fold_ok(const T&) { return std::numeric_limits<int>::min(); }
 		template<class T> static int null_fold_score(const T& lhs, const T& rhs) { return std::numeric_limits<int>::min(); }
 		template<class T> static T null_eval(const T& lhs, const T& rhs) { return 0; }
+
+		// Pair scores for the fold heuristic, kept across fold steps.  Terms are identified by address, validated by
+		// structural hash; only pairs involving new or changed terms are scored.  After a fold step that was the owner's
+		// only change, only the slots it touched are looked at again.
+		class fold_queue {
+		public:
+			using smart_ptr = eval_to_ptr<fp_API>::eval_type;
+
+		private:
+			struct term_spec {
+				size_t hash;
+				size_t generation;
+				size_t queued;	// entries naming this term
+				bool legal;
+			};
+
+			struct candidate {
+				int score;
+				size_t seq;	// ties go to the older pair
+				const fp_API* lhs;
+				size_t lhs_generation;
+				const fp_API* rhs;
+				size_t rhs_generation;
+			};
+
+			struct lower_priority {
+				bool operator()(const candidate& lhs, const candidate& rhs) const { return lhs.score < rhs.score || (lhs.score == rhs.score && lhs.seq > rhs.seq); }
+			};
+
+			std::unordered_map<const fp_API*, term_spec> _terms;
+			std::vector<const fp_API*> _slots;	// the terms, as of the last update
+			std::unordered_map<const fp_API*, size_t> _index;	// inverse of _slots
+			std::vector<candidate> _queue;	// heap
+			std::vector<size_t> _touched;	// slots changed by the last fold step
+			size_t _changes = SIZE_MAX;	// owner's change count if the last fold step was its only change since
+			size_t _stale = 0;	// queue entries naming a dead or changed term; may overcount, which only compacts sooner
+			size_t _seq = 0;
+			size_t _generation = 0;
+
+			bool _live(const fp_API* src, size_t generation) const {
+				const auto spec = _terms.find(src);
+				return _terms.end() != spec && generation == spec->second.generation;
+			}
+
+			void _forget(const fp_API* src) {
+				const auto spec = _terms.find(src);
+				if (_terms.end() == spec) return;
+				_stale += spec->second.queued;
+				_terms.erase(spec);
+			}
+
+			void _dequeue(const candidate& src) {	// one entry fewer naming its live terms
+				if (_live(src.lhs, src.lhs_generation)) --_terms[src.lhs].queued;
+				if (_live(src.rhs, src.rhs_generation)) --_terms[src.rhs].queued;
+			}
+
+			void _compact() {
+				std::erase_if(_queue, [&](const candidate& x) {
+					if (_live(x.lhs, x.lhs_generation) && _live(x.rhs, x.rhs_generation)) return false;
+					_dequeue(x);
+					return true;
+				});
+				std::ranges::make_heap(_queue, lower_priority());
+				_stale = 0;
+			}
+
+			struct stats {
+				size_t checked = 0;	// slots looked at again by update
+				size_t scored = 0;	// fold_score calls
+			};
+			static stats& _stats() {
+				static thread_local stats ret;
+				return ret;
+			}
+
+		public:
+			static const stats& statistics() { return _stats(); }	// this thread's
+
+			// changes: the owner's change count
+			void update(const std::vector<smart_ptr>& x, int (*fold_ok)(const smart_ptr&), int (*fold_score)(const smart_ptr&, const smart_ptr&), size_t changes) {
+				const size_t ub = x.size();
+				const bool incremental = changes == _changes && _slots.size() == ub;
+				_changes = SIZE_MAX;
+				std::vector<size_t> check;
+				if (incremental) {
+					check = std::move(_touched);
+					std::ranges::sort(check);
+				} else {
+					check.resize(ub);
+					for (size_t i = 0; i < ub; ++i) check[i] = i;
+					_slots.assign(ub, nullptr);
+					_index.clear();
+				}
+				_touched.clear();
+
+				_stats().checked += check.size();
+				std::vector<size_t> fresh;
+				for (const auto i : check) {
+					const auto src = x[i].get_c();
+					const auto hash = src->structural_hash();
+					if (incremental) {
+						const auto prior = _slots[i];
+						if (prior && prior != src) {
+							const auto at = _index.find(prior);
+							if (_index.end() != at && i == at->second) {	// moved away, not elsewhere
+								_index.erase(at);
+								_forget(prior);
+							}
+						}
+					}
+					_slots[i] = src;
+					_index[src] = i;
+					auto& spec = _terms[src];
+					if (spec.generation && spec.hash == hash) continue;
+					if (spec.generation) _stale += spec.queued;
+					spec = term_spec{ hash, ++_generation, 0, std::numeric_limits<int>::min() < fold_ok(x[i]) };
+					if (spec.legal) fresh.push_back(i);
+				}
+				if (!incremental) {
+					for (auto entry = _terms.begin(); _terms.end() != entry; ) {
+						if (_index.contains(entry->first)) ++entry;
+						else {
+							_stale += entry->second.queued;
+							entry = _terms.erase(entry);
+						}
+					}
+				}
+
+				if (!fresh.empty()) {
+					std::vector<size_t> legal;
+					for (size_t i = 0; i < ub; ++i) {
+						if (_terms[_slots[i]].legal) legal.push_back(i);
+					}
+					for (const auto i : fresh) {
+						for (const auto j : legal) {
+							if (i == j) continue;
+							if (j > i && std::ranges::binary_search(fresh, j)) continue;	// scored from the other side
+							const auto lo = i < j ? i : j;
+							const auto hi = i < j ? j : i;
+							const auto score = fold_score(x[hi], x[lo]);
+							++_stats().scored;
+							if (std::numeric_limits<int>::min() == score) continue;
+							auto& lhs = _terms[_slots[lo]];
+							auto& rhs = _terms[_slots[hi]];
+							++lhs.queued;
+							++rhs.queued;
+							_queue.push_back(candidate{ score, _seq++, _slots[lo], lhs.generation, _slots[hi], rhs.generation });
+							std::ranges::push_heap(_queue, lower_priority());
+						}
+					}
+				}
+				if (_queue.size() < 2 * _stale) _compact();	// stale entries outnumber live ones
+			}
+
+			// best remaining pair as of the last update, as (index of lhs, index of rhs, score); stale pairs are discarded
+			std::optional<std::pair<std::pair<size_t, size_t>, int> > top() {
+				while (!_queue.empty()) {
+					const auto& test = _queue.front();
+					if (_live(test.lhs, test.lhs_generation) && _live(test.rhs, test.rhs_generation)) {
+						return std::pair(std::pair(_index[test.lhs], _index[test.rhs]), test.score);
+					}
+					pop();
+					if (_stale) --_stale;
+				}
+				return std::nullopt;
+			}
+
+			void pop() {
+				std::ranges::pop_heap(_queue, lower_priority());
+				_dequeue(_queue.back());
+				_queue.pop_back();
+			}
+
+			// The owner folded the terms at lhs and rhs, filled the holes from the back, and appended the result.  changes:
+			// the owner's change count once the step is done.
+			void folded(size_t lhs, size_t rhs, size_t changes) {
+				_index.erase(_slots[lhs]);
+				_index.erase(_slots[rhs]);
+				_forget(_slots[lhs]);
+				_forget(_slots[rhs]);
+				for (const auto i : { lhs < rhs ? rhs : lhs, lhs < rhs ? lhs : rhs }) {
+					if (_slots.size() - 1 > i) {
+						_slots[i] = _slots.back();
+						_index[_slots[i]] = i;
+						_touched.push_back(i);
+					}
+					_slots.pop_back();
+				}
+				_slots.push_back(nullptr);
+				_touched.push_back(_slots.size() - 1);
+				_changes = changes;
+			}
+		};
+
+		// Whole-node properties that would otherwise walk every term, computed on first query.  The owner clears them
+		// whenever it or a term may have changed.  Queries on a shared node may race, but they all store the same values.
+		class properties {
+			enum : unsigned {
+				sgn_known = 1,
+				sgn_shift = 1,	// 2 bits: sgn + 1, or 3 if indeterminate
+				finite_known = 1U << 3,
+				finite_shift = 4,	// 2 bits: false, true, unknown
+				ideal_known = 1U << 6,
+				hash_known = 1U << 7
+			};
+
+			std::atomic<unsigned> _known = 0;
+			std::atomic<const math::type*> _domain = nullptr;
+			std::atomic<intmax_t> _ideal_scal_bn = 0;
+			std::atomic<size_t> _hash = 0;	// structural
+			// last scal_bn_is_safe query, as a sequence lock.  0: empty; odd: being written.  A writer that loses the race
+			// does not store.
+			std::atomic<unsigned> _safe_seq = 0;
+			std::atomic<intmax_t> _safe_scale = 0;
+			std::atomic<intmax_t> _safe_result = 0;
+
+		public:
+			properties() = default;
+			properties(const properties& src) noexcept { *this = src; }
+			~properties() = default;
+			properties& operator=(const properties& src) noexcept {
+				if (this == &src) return *this;
+				_known.store(src._known.load(std::memory_order_acquire), std::memory_order_relaxed);	// before the values it covers
+				_domain.store(src._domain.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				_ideal_scal_bn.store(src._ideal_scal_bn.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				_hash.store(src._hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				_safe_seq.store(0, std::memory_order_relaxed);
+				return *this;
+			}
+
+			void clear() noexcept {
+				_known.store(0, std::memory_order_relaxed);
+				_domain.store(nullptr, std::memory_order_relaxed);
+				_safe_seq.store(0, std::memory_order_relaxed);
+			}
+
+			// for changes to the node itself that leave its value-derived properties alone
+			void clear_hash() noexcept { _known.fetch_and(~hash_known, std::memory_order_relaxed); }
+
+			// f returns std::nullopt if the sign cannot be determined without evaluating
+			template<class F> std::optional<int> sgn(F f) {
+				const auto known = _known.load(std::memory_order_relaxed);
+				if (known & sgn_known) {
+					const int code = (known >> sgn_shift) & 3;
+					if (3 == code) return std::nullopt;
+					return code - 1;
+				}
+				const std::optional<int> ret = f();
+				_known.fetch_or(sgn_known | ((ret ? *ret + 1 : 3) << sgn_shift), std::memory_order_relaxed);
+				return ret;
+			}
+
+			template<class F> std::optional<bool> is_finite(F f) {
+				const auto known = _known.load(std::memory_order_relaxed);
+				if (known & finite_known) {
+					const int code = (known >> finite_shift) & 3;
+					if (2 == code) return std::nullopt;
+					return 1 == code;
+				}
+				const std::optional<bool> ret = f();
+				_known.fetch_or(finite_known | ((ret ? (*ret ? 1U : 0U) : 2U) << finite_shift), std::memory_order_relaxed);
+				return ret;
+			}
+
+			template<class F> const math::type* domain(F f) {
+				if (const auto ret = _domain.load(std::memory_order_relaxed)) return ret;
+				const auto ret = f();
+				_domain.store(ret, std::memory_order_relaxed);
+				return ret;
+			}
+
+			template<class F> intmax_t ideal_scal_bn(F f) {
+				if (_known.load(std::memory_order_acquire) & ideal_known) return _ideal_scal_bn.load(std::memory_order_relaxed);
+				const intmax_t ret = f();
+				_ideal_scal_bn.store(ret, std::memory_order_relaxed);
+				_known.fetch_or(ideal_known, std::memory_order_release);
+				return ret;
+			}
+
+			template<class F> size_t structural_hash(F f) {
+				if (_known.load(std::memory_order_acquire) & hash_known) return _hash.load(std::memory_order_relaxed);
+				const size_t ret = f();
+				_hash.store(ret, std::memory_order_relaxed);
+				_known.fetch_or(hash_known, std::memory_order_release);
+				return ret;
+			}
+
+			template<class F> intmax_t scal_bn_is_safe(intmax_t scale, F f) {
+				auto seq = _safe_seq.load(std::memory_order_acquire);
+				if (seq && !(seq & 1) && scale == _safe_scale.load(std::memory_order_relaxed)) {
+					const auto ret = _safe_result.load(std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (seq == _safe_seq.load(std::memory_order_relaxed)) return ret;
+				}
+				const intmax_t ret = f();
+				if (!(seq & 1) && _safe_seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+					std::atomic_thread_fence(std::memory_order_release);
+					_safe_scale.store(scale, std::memory_order_relaxed);
+					_safe_result.store(ret, std::memory_order_relaxed);
+					_safe_seq.store(seq + 2, std::memory_order_release);
+				}
+				return ret;
+			}
+		};
 	};
 
 	// associative operations naturally are n-ary
@@ -33,15 +350,42 @@ namespace zaimoni {
 	protected:
 		std::vector<smart_ptr> _x;
 		std::vector<eval_spec> _heuristic;
+		size_t _parallel_seen = 0;	// term count after the last parallel reduction
+		std::unique_ptr<_n_ary_op::fold_queue> _fold;	// only while folding; keeps small nodes poolable.  Copies start over.
+		mutable _n_ary_op::properties _properties;	// cleared by any change to _x or a term
+		size_t _changes = 0;	// counts the same changes, for passes that need only rerun after one
+		bool _local = false;	// in local_self_eval: the terms are evaluated by the caller
 
 		n_ary_op() = default;
-		n_ary_op(const n_ary_op& src) = default;
-		n_ary_op(n_ary_op&& src) = default;
+		n_ary_op(const n_ary_op& src) : _x(src._x), _heuristic(src._heuristic), _parallel_seen(src._parallel_seen), _properties(src._properties), _changes(src._changes) {}
+		n_ary_op(n_ary_op&& src) noexcept : _x(std::move(src._x)), _heuristic(std::move(src._heuristic)), _parallel_seen(src._parallel_seen), _fold(std::move(src._fold)), _properties(src._properties), _changes(src._changes) {}
 		~n_ary_op() = default;
-		n_ary_op& operator=(const n_ary_op& src) = default;
-		n_ary_op& operator=(n_ary_op&& src) = default;
+		n_ary_op& operator=(const n_ary_op& src) {
+			_x = src._x;
+			_heuristic = src._heuristic;
+			_parallel_seen = src._parallel_seen;
+			_fold.reset();
+			_properties = src._properties;
+			_changes = src._changes;
+			return *this;
+		}
+		n_ary_op& operator=(n_ary_op&& src) noexcept {
+			_x = std::move(src._x);
+			_heuristic = std::move(src._heuristic);
+			_parallel_seen = src._parallel_seen;
+			_fold = std::move(src._fold);
+			_properties = src._properties;
+			_changes = src._changes;
+			return *this;
+		}
+
+		void _changed() noexcept {
+			_properties.clear();
+			++_changes;
+		}
 
 		void _append_term(const smart_ptr& src) {
+			_changed();
 			if (!_x.empty()) {
 				if (_heuristic.empty() || _n_ary_op::linear_scan != _heuristic.back().first) _heuristic.push_back(eval_spec(_n_ary_op::linear_scan, _x.size()));
 			}
@@ -49,6 +393,7 @@ namespace zaimoni {
 		}
 
 		void _append_term(smart_ptr&& src) {
+			_changed();
 			if (!_x.empty()) {
 				if (_heuristic.empty() || _n_ary_op::linear_scan != _heuristic.back().first) _heuristic.push_back(eval_spec(_n_ary_op::linear_scan, _x.size()));
 			}
@@ -58,6 +403,31 @@ namespace zaimoni {
 
 		virtual bool would_fpAPI_eval() const = 0;
 
+		// wraps a rewrite step that returns true if it changed anything
+		template<class F> bool _rewrite(F step) {
+			try {
+				if (!step()) return false;
+			} catch (...) {
+				_changed();	// may have changed
+				throw;
+			}
+			_changed();
+			return true;
+		}
+
+		// local_self_eval: as _rewrite, skipping componentwise evaluation
+		template<class F> bool _local_rewrite(F step) {
+			_local = true;
+			try {
+				const bool ret = _rewrite(step);
+				_local = false;
+				return ret;
+			} catch (...) {
+				_local = false;
+				throw;
+			}
+		}
+
 		bool _pre_self_eval()
 		{
 		restart:
@@ -88,6 +458,67 @@ namespace zaimoni {
 			return true;
 		}
 
+		// Each block of parallel_block terms is evaluated as its own Derived, and the terms replaced by the block results in
+		// order.  Interactions across blocks are left to the usual heuristics.
+		bool _parallel_self_eval()
+		{
+			const size_t ub = _x.size();
+			if (_n_ary_op::parallel_threshold > ub || _parallel_seen >= ub) return false;
+			_parallel_seen = ub;
+			const size_t blocks = (ub + _n_ary_op::parallel_block - 1) / _n_ary_op::parallel_block;
+			size_t threads = _n_ary_op::parallel_threads ? _n_ary_op::parallel_threads : std::thread::hardware_concurrency();
+			if (blocks < threads) threads = blocks;
+			if (1 > threads) threads = 1;
+
+			// workers see our terms read-only, so they never free them.  Inline leaves are copied, not shared.
+			for (decltype(auto) x : _x) if (!x.is_local()) x.share();
+			const auto& src = _x;
+			std::vector<std::vector<smart_ptr> > partial(blocks);
+			std::vector<std::exception_ptr> failed(blocks);
+			const int rounding = std::fegetround();
+
+			auto work = [&](size_t first) {
+				std::fesetround(rounding);
+				node_pool::scope arena;	// block results outlive it; they may be freed on any thread (see node_pool)
+				for (size_t b = first; b < blocks; b += threads) {
+					try {
+						Derived stage;
+						const size_t i_ub = (b + 1) * _n_ary_op::parallel_block < ub ? (b + 1) * _n_ary_op::parallel_block : ub;
+						for (size_t i = b * _n_ary_op::parallel_block; i < i_ub; ++i) stage.append_term(src[i]);
+						while (_local ? *stage.local_self_eval() : stage.self_eval());
+						const size_t n = stage.arity();
+						for (size_t i = 0; i < n; ++i) partial[b].push_back(std::move(*stage.term(i)));
+					} catch (...) {
+						failed[b] = std::current_exception();
+					}
+				}
+			};
+
+			if (1 == threads) work(0);
+			else {
+				std::vector<std::jthread> pool;
+				pool.reserve(threads - 1);
+				for (size_t t = 1; t < threads; ++t) pool.emplace_back(work, t);
+				work(0);
+			}	// joined here
+			for (decltype(auto) x : failed) if (x) std::rethrow_exception(x);
+
+			std::vector<smart_ptr> merged;
+			merged.reserve(ub);
+			for (decltype(auto) block : partial) {
+				for (decltype(auto) x : block) merged.push_back(std::move(x));
+			}
+			bool changed = ub != merged.size();
+			for (size_t i = 0; !changed && i < ub; ++i) changed = src[i].get_c() != merged[i].get_c();
+			if (!changed) return false;
+			_x = std::move(merged);
+			_parallel_seen = _x.size();
+			_heuristic.clear();
+			// the first block's results are already known not to interact: start the pairwise scan at its boundary
+			_heuristic.push_back(eval_spec(_n_ary_op::linear_scan, 1 < partial.front().size() ? partial.front().size() : 1));
+			return true;
+		}
+
 		bool _self_eval(int (*rearrange)(smart_ptr&, smart_ptr&), int (*fold_ok)(const smart_ptr&), int (*fold_score)(const smart_ptr&, const smart_ptr&), smart_ptr(*fold)(const smart_ptr&, const smart_ptr&))
 		{
 		restart:
@@ -96,60 +527,29 @@ namespace zaimoni {
 			{
 			case _n_ary_op::fold:
 			{
-				std::vector<size_t> legal;
-				std::map<size_t, int> legal_scores;
-				const size_t ub = _x.size();
-				ptrdiff_t i = -1;
-				while (ub > ++i) {
-					auto score = fold_ok(_x[i]);
-					if (std::numeric_limits<int>::min() < score) {
-						legal.push_back(i);
-						legal_scores[i] = score;
-					}
-				}
-				const size_t legal_ub = legal.size();
-				if (2 > legal_ub) {
-					_heuristic.pop_back();
-					if (_pre_self_eval()) goto restart;
-					return false;
-				}
-				std::map<std::pair<size_t, size_t>, int> possible;
-				i = 0;
-				while (legal_ub > ++i) {
-					ptrdiff_t j = -1;
-					while (i > ++j) {
-						auto score = fold_score(_x[legal[i]], _x[legal[j]]);
-						if (std::numeric_limits<int>::min() < score) {
-							bool ok = true;
-							if (!possible.empty()) {
-								for (const auto& x : possible) {
-									if (x.second > score) {
-										ok = false;
-										break;
-									}
-									else if (x.second < score) {
-										possible.clear();
-										break;
-									}
-								}
-							}
-							if (ok) possible[std::pair<size_t, size_t>(j, i)] = score;
+				if (!_fold) _fold = std::make_unique<_n_ary_op::fold_queue>();
+				_fold->update(_x, fold_ok, fold_score, _changes);
+				const auto best = _fold->top();
+				if (best) {
+					const size_t ub = _x.size();
+					while (const auto test = _fold->top()) {
+						if (test->second < best->second) break;	// only the best-scoring pairs are tried
+						_fold->pop();
+						const auto [lhs, rhs] = test->first;
+						auto result = fold(_x[lhs], _x[rhs]);
+						if (!result) continue;
+						// fill the holes from the back rather than shifting: inline terms that move must be rescored
+						for (const auto i : { lhs < rhs ? rhs : lhs, lhs < rhs ? lhs : rhs }) {
+							if (_x.size() - 1 > i) _x[i] = std::move(_x.back());
+							_x.pop_back();
 						}
+						_x.push_back(std::move(result));
+						_fold->folded(lhs, rhs, _changes + 1);	// _rewrite counts this step
+						_heuristic.push_back(eval_spec(_n_ary_op::linear_scan, ub - 2));
+						return true;
 					}
 				}
-				while (!possible.empty()) {
-					const auto test = *possible.begin();
-					auto result = fold(_x[test.first.first], _x[test.first.second]);
-					if (!result) {
-						possible.erase(test.first);
-						continue;
-					}
-					_x.erase(_x.begin() + test.first.second);
-					_x.erase(_x.begin() + test.first.first);
-					_x.push_back(result);
-					_heuristic.push_back(eval_spec(_n_ary_op::linear_scan, ub - 2));
-					return true;
-				}
+				_fold.reset();
 				_heuristic.pop_back();
 				if (_pre_self_eval()) goto restart;
 				return false;
@@ -216,7 +616,7 @@ namespace zaimoni {
 			return true;
 			case _n_ary_op::componentwise_evaluation:
 			{
-				const auto strict_ub = _x.size();
+				const auto strict_ub = _local ? checking.second : _x.size();
 				while (strict_ub > checking.second) {
 					auto& viewpoint = _x[checking.second];
 					if (viewpoint->self_eval()) {
@@ -1,6 +1,7 @@
 #include "power_fp.hpp"
 #include "arithmetic.hpp"
 #include "Zaimoni.STL/var.hpp"
+#include <array>
 
 namespace zaimoni {
 
@@ -15,6 +16,42 @@ enum {
 	reset_eval = algebraic_eval * eval_strict_ub + algebraic_eval
 };
 
+namespace {
+
+struct power_cache_entry {
+	size_t hash = 0;
+	COW<fp_API> base;
+	COW<fp_API> exponent;
+	COW<fp_API> result;
+};
+
+}
+
+static thread_local std::array<power_cache_entry, power_fp::cache_size> _cache;
+static thread_local power_fp::cache_stats _cache_stats;
+
+const power_fp::cache_stats& power_fp::cache_statistics() { return _cache_stats; }
+
+void power_fp::clear_cache() {
+	_cache.fill(power_cache_entry());
+	_cache_stats = cache_stats();
+}
+
+// INTMAX_MIN excluded, so that the result negates
+static std::optional<intmax_t> integer_exponent(const fp_API& src)
+{
+	switch (src.leaf_tag()) {
+	case fp_leaf::s_int:
+		if (const auto x = static_cast<const var_fp<intmax_t>&>(src)._x; INTMAX_MIN < x) return x;
+		break;
+	case fp_leaf::u_int:
+		if (const auto x = static_cast<const var_fp<uintmax_t>&>(src)._x; INTMAX_MAX >= x) return intmax_t(x);
+		break;
+	default: break;
+	}
+	return std::nullopt;
+}
+
 power_fp::power_fp(const decltype(base)& x, const decltype(exponent)& y) noexcept
 	: base(x), exponent(y), heuristic(reset_eval) {
 	would_destructive_eval();
@@ -98,6 +135,14 @@ int power_fp::sgn() const {
 	throw zaimoni::math::numeric_error("unhandled sgn() for power_fp");
 }
 
+const power_fp::eval_type* power_fp::term_c(size_t n) const {
+	switch (n) {
+	case 0: return &base;
+	case 1: return &exponent;
+	default: return nullptr;
+	}
+}
+
 std::string power_fp::to_s() const {
 	auto ret(base->to_s());
 	if (std::numeric_limits<int>::max() > base->precedence()) ret = "(" + ret + ")";
@@ -105,8 +150,27 @@ std::string power_fp::to_s() const {
 	return ret;
 }
 
+// (x*2^k)^n is x^n*2^(kn), for integer n
+intmax_t power_fp::scal_bn_is_safe(intmax_t scale) const {
+	const auto n = integer_exponent(*exponent.get_c());
+	if (!n || 0 == *n) return 0;
+	return base->scal_bn_is_safe(scale / *n) * *n;
+}
+
+intmax_t power_fp::ideal_scal_bn() const {
+	const auto n = integer_exponent(*exponent.get_c());
+	if (!n || 0 == *n) return 0;
+	const intmax_t ret = base->ideal_scal_bn();
+	if (0 == ret || INTMAX_MAX / (0 > ret ? -ret : ret) < (0 > *n ? -*n : *n)) return 0;
+	return ret * *n;
+}
+
 void power_fp::_scal_bn(intmax_t scale) {
-	throw zaimoni::math::numeric_error("power_fp: unhandled power-of-two scaling");
+	const auto n = integer_exponent(*exponent.get_c());
+	if (!n || 0 == *n || 0 != scale % *n) throw zaimoni::math::numeric_error("power_fp: unhandled power-of-two scaling");
+	base->scal_bn(scale / *n);
+	heuristic = reset_eval;
+	would_destructive_eval();
 }
 
 enum {
@@ -115,26 +179,26 @@ enum {
 	is_base = -1
 };
 
-bool power_fp::would_destructive_eval() const
+bool power_fp::would_destructive_eval()
 {
 	if (0 > heuristic) return is_base == heuristic;
-	if (base->is_one()) {
+	if (base.get_c()->is_one()) {
 		heuristic = is_base;
 		return true;
 	}
-	if (exponent->is_one()) {
+	if (exponent.get_c()->is_one()) {
 		heuristic = is_base;
 		return true;
 	}
-	if (base->is_zero()) {
-		if (exponent->is_zero()) {
+	if (base.get_c()->is_zero()) {
+		if (exponent.get_c()->is_zero()) {
 			heuristic = zero_to_zero;
 			return false;
 		}
 		heuristic = is_base;
 		return true;
 	}
-	if (exponent->is_zero()) {
+	if (exponent.get_c()->is_zero()) {
 		heuristic = eval_to_zero;
 		return false;
 	}
@@ -223,7 +287,24 @@ fp_API* power_fp::_eval() const {
 	}
 	case zero_to_zero: throw zaimoni::math::numeric_error("tried to evaluate 0^0");
 	}
-	return nullptr;
+	if (0 > heuristic) return nullptr;
+	const auto b = base.get_c();
+	const auto e = exponent.get_c();
+	if (fp_leaf::none == b->leaf_tag() || fp_leaf::none == e->leaf_tag()) return nullptr;
+
+	const size_t h = hash_combine(b->structural_hash(), e->structural_hash());
+	auto& slot = _cache[h % cache_size];
+	++_cache_stats.lookups;
+	if (slot.result && h == slot.hash && b->structural_equal(*slot.base.get_c()) && e->structural_equal(*slot.exponent.get_c())) {
+		++_cache_stats.hits;
+		return slot.result.get_c()->clone();
+	}
+	auto ret = zaimoni::math::eval_power(base, exponent);
+	if (ret && fp_leaf::none != ret->leaf_tag()) {	// leaves only: no shared subtrees to pin
+		node_pool::heap_scope unpooled;	// thread-lifetime; must not keep the caller's arena alive
+		slot = power_cache_entry{ h, COW<fp_API>(b->clone()), COW<fp_API>(e->clone()), COW<fp_API>(ret->clone()) };
+	}
+	return ret;
 }
 
 } // namespace zaimoni
\ No newline at end of file
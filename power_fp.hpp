@@ -9,10 +9,18 @@ namespace zaimoni {
 	class power_fp final : public fp_API, public eval_to_ptr<fp_API> {
 		eval_type base;
 		eval_type exponent;
-		mutable signed char heuristic;
+		signed char heuristic;
 		//	_type_spec::canonical_functions op;
 
 	public:
+		// leaf bases to integer leaf powers, when the result is a leaf; per thread, held on the global heap
+		struct cache_stats {
+			size_t lookups = 0;
+			size_t hits = 0;
+		};
+
+		static constexpr size_t cache_size = 64;	// direct-mapped
+
 		//	template<_type_spec::canonical_functions _op> // doesn't work -- uncallable?
 		power_fp(const decltype(base)& x, const decltype(exponent)& y) noexcept;
 		power_fp(const decltype(base)& x, decltype(exponent)&& y) noexcept;
@@ -27,6 +35,9 @@ namespace zaimoni {
 
 		bool self_square();
 
+		static const cache_stats& cache_statistics();
+		static void clear_cache();
+
 		// eval_to_ptr<fp_API>
 		eval_type destructive_eval() override;
 		bool algebraic_self_eval() override;
@@ -41,8 +52,8 @@ namespace zaimoni {
 
 		bool is_scal_bn_identity() const override { return is_scal_bn_identity_default(); }
 
-		intmax_t scal_bn_is_safe(intmax_t scale) const override { return 0; } // stub
-		intmax_t ideal_scal_bn() const override { return 0; } // stub
+		intmax_t scal_bn_is_safe(intmax_t scale) const override;
+		intmax_t ideal_scal_bn() const override;
 
 		fp_API* clone() const override {
 			return new power_fp(*this);
@@ -53,8 +64,12 @@ namespace zaimoni {
 		// coordinate with the sum/product types
 		int precedence() const override { return _type_spec::Multiplication + 1; }
 
+		size_t arity() const override { return 2; }
+		const eval_type* term_c(size_t n) const override;
+		eval_type* term(size_t n) override { return const_cast<eval_type*>(const_cast<const power_fp*>(this)->term_c(n)); }
+
 private:
-		bool would_destructive_eval() const;
+		bool would_destructive_eval();
 
 		void _scal_bn(intmax_t scale) override;
 		fp_API* _eval() const override;
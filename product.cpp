@@ -1,6 +1,7 @@
 #include "product.hpp"
 #include "Zaimoni.STL/numeric_error.hpp"
 #include "Zaimoni.STL/Logging.h"
+#include <algorithm>
 
 namespace zaimoni {
 
@@ -20,8 +21,9 @@ void product::_append_zero(const smart_ptr& src) {
 
 void product::_append(smart_ptr&& src)
 {
-	if (src->is_zero()) _append_zero(src);	// mostly an annihilator
-	this->_append_term(src);
+	if (src.get_c()->is_zero()) _append_zero(src);	// mostly an annihilator
+	this->_append_term(std::move(src));
+	_reassociate_pending = true;
 }
 
 void product::append_term(const smart_ptr& src) {
@@ -31,8 +33,8 @@ void product::append_term(const smart_ptr& src) {
 }
 
 void product::append_term(smart_ptr&& src) {
-	if (!src || src->is_one()) return;
-	assert(src->domain());
+	if (!src || src.get_c()->is_one()) return;	// non-const access would unshare src
+	assert(src.get_c()->domain());
 	_append(std::move(src));
 }
 
@@ -40,13 +42,18 @@ bool product::would_fpAPI_eval() const { return 1 >= this->_x.size(); }
 
 // eval_to_ptr
 product::eval_type product::destructive_eval() {
-	if (1 == this->_x.size()) return std::move(this->_x.front());
+	if (1 == this->_x.size()) {
+		this->_changed();
+		return std::move(this->_x.front());
+	}
 	return 0;
 }
 
 // fp_API
-bool product::self_eval() {
+bool product::_self_eval_step() {
 	if (!this->_pre_self_eval()) return false;
+	if (this->_parallel_self_eval()) return true;
+	if (_reassociate()) return true;
 	if (this->_self_eval(zaimoni::math::rearrange_product, zaimoni::math::product_score, zaimoni::math::product_score, zaimoni::math::eval_product)) return true;
 	//		auto& checking = this->_heuristic.back();
 	// \todo process our specific rules
@@ -54,6 +61,108 @@ bool product::self_eval() {
 	return false;
 }
 
+// Matrix-chain dynamic programming over the factors with a cost class (math::cost_class); a pair costs the adds plus
+// multiplies of math::op_count_product, and a group is costed as the class of its product.  As multiplication is
+// commutative, factors are ordered by class first, so like factors are adjacent.  The grouping is applied, as nested
+// products, only if it is cheaper than the greedy fold would be.  Integer leaves are left out: they only fold with
+// each other, exactly.  Runs once per batch of appended factors, not per fold step.
+bool product::_reassociate()
+{
+	if (!_reassociate_pending) return false;
+	_reassociate_pending = false;
+
+	using cost_class = math::product_cost_class;
+	std::vector<std::pair<cost_class, size_t> > costed;
+	for (size_t i = 0; i < _x.size(); ++i) {
+		const auto test = math::cost_class(_x[i]);
+		if (!test || (!test->complex && cost_class::integer == test->leaf)) continue;
+		costed.push_back(std::pair(*test, i));
+	}
+	const size_t n = costed.size();
+	if (3 > n || reassociate_limit < n) return false;
+	std::stable_sort(costed.begin(), costed.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.first.complex < rhs.first.complex || (lhs.first.complex == rhs.first.complex && lhs.first.leaf < rhs.first.leaf);
+	});
+
+	auto cost = [](const cost_class& lhs, const cost_class& rhs) {
+		const auto ops = math::op_count_product(lhs, rhs);
+		int total = ops.first;
+		clamped_sum_assign(total, ops.second);
+		return total;
+	};
+
+	// factors i..j of costed: best cost, class of the product, split point
+	std::vector<int> best(n * n, 0);
+	std::vector<cost_class> cls(n * n);
+	std::vector<size_t> split(n * n);
+	for (size_t i = 0; i < n; ++i) cls[i * n + i] = costed[i].first;
+	for (size_t len = 2; len <= n; ++len) {
+		for (size_t i = 0; i + len <= n; ++i) {
+			const size_t j = i + len - 1;
+			int& dest = best[i * n + j];
+			dest = std::numeric_limits<int>::max();
+			for (size_t k = i; k < j; ++k) {
+				int test = best[i * n + k];
+				clamped_sum_assign(test, best[(k + 1) * n + j]);
+				clamped_sum_assign(test, cost(cls[i * n + k], cls[(k + 1) * n + j]));
+				if (test < dest) {
+					dest = test;
+					split[i * n + j] = k;
+				}
+			}
+			const size_t k = split[i * n + j];
+			cls[i * n + j] = cls[i * n + k] * cls[(k + 1) * n + j];
+		}
+	}
+
+	// what the fold would do: cheapest pair first
+	int greedy = 0;
+	{
+	std::vector<cost_class> working;
+	for (decltype(auto) x : costed) working.push_back(x.first);
+	while (1 < working.size()) {
+		size_t lhs = 0;
+		size_t rhs = 1;
+		int lowest = std::numeric_limits<int>::max();
+		for (size_t i = 0; i < working.size(); ++i) {
+			for (size_t j = i + 1; j < working.size(); ++j) {
+				const int test = cost(working[i], working[j]);
+				if (test < lowest) {
+					lowest = test;
+					lhs = i;
+					rhs = j;
+				}
+			}
+		}
+		clamped_sum_assign(greedy, lowest);
+		working[lhs] = working[lhs] * working[rhs];
+		working.erase(working.begin() + rhs);
+	}
+	}
+	if (best[n - 1] >= greedy) return false;
+
+	auto build = [&](auto& self, size_t i, size_t j) -> smart_ptr {
+		if (i == j) return std::move(_x[costed[i].second]);
+		const size_t k = split[i * n + j];
+		auto stage = std::unique_ptr<product>(new product());
+		stage->append_term(self(self, i, k));
+		stage->append_term(self(self, k + 1, j));
+		return smart_ptr(static_cast<fp_API*>(stage.release()));
+	};
+	const size_t k = split[n - 1];
+	auto lhs = build(build, 0, k);
+	auto rhs = build(build, k + 1, n - 1);
+	std::vector<smart_ptr> stage;
+	for (decltype(auto) x : _x) if (x) stage.push_back(std::move(x));
+	stage.push_back(std::move(lhs));
+	stage.push_back(std::move(rhs));
+	_x = std::move(stage);
+	_fold.reset();
+	_heuristic.clear();
+	_heuristic.push_back(eval_spec(_n_ary_op::componentwise_evaluation, 0));
+	return true;
+}
+
 bool product::is_zero() const {
 	if (1 == this->_x.size()) return this->_x.front()->is_zero();
 	return false;
@@ -65,7 +174,9 @@ bool product::is_one() const {
 	return false;
 }
 
-int product::sgn() const {
+int product::sgn() const { return *this->_properties.sgn([this] { return std::optional<int>(_sgn()); }); }
+
+int product::_sgn() const {
 	if (this->_x.empty()) return 1;
 	int ret = 1;
 	for (decltype(auto) x: this->_x) {
@@ -75,7 +186,7 @@ int product::sgn() const {
 	return ret;
 }
 
-intmax_t product::scal_bn_is_safe(intmax_t scale) const {
+intmax_t product::_scal_bn_is_safe(intmax_t scale) const {
 	intmax_t to_account_for = scale;
 	for (const auto& x : this->_x) {
 		if (x->is_scal_bn_identity()) return scale;
@@ -86,7 +197,7 @@ intmax_t product::scal_bn_is_safe(intmax_t scale) const {
 	return scale - to_account_for;
 }
 
-intmax_t product::ideal_scal_bn() const {
+intmax_t product::_ideal_scal_bn() const {
 	if (is_scal_bn_identity() || is_one()) return 0;
 	intmax_t ret = 0;
 	for (const auto& x : this->_x) {
@@ -97,7 +208,7 @@ intmax_t product::ideal_scal_bn() const {
 	return ret;
 }
 
-const math::type* product::domain() const
+const math::type* product::_domain() const
 {
 	if (_x.empty()) return &math::get<_type<_type_spec::_R_SHARP_>>(); // omni-one is unconstrained \todo should be integers
 	std::vector<decltype(domain())> accumulator;
@@ -137,7 +248,7 @@ std::string product::to_s() const {
 	return ret;
 }
 
-std::optional<bool> product::_is_finite() const {
+std::optional<bool> product::_terms_finite() const {
 	for (auto& x : this->_x) {
 		if (const auto test = x->is_finite_kripke()) {
 			if (!*test) return false;
@@ -147,6 +258,7 @@ std::optional<bool> product::_is_finite() const {
 }
 
 void product::_scal_bn(intmax_t scale) {
+	this->_changed();
 	bool saw_identity = false;
 	// \todo both of these loops can be specialized (scale positive/negative will be invariant)
 	for (auto& x : this->_x) {
@@ -10,7 +10,11 @@ class product final : public fp_API, public eval_to_ptr<fp_API>, protected n_ary
 {
 	enum { strict_max_heuristic = _n_ary_op::strict_max_core_heuristic };
 
+	bool _reassociate_pending = true;	// factors were appended since the last reassociation attempt
+
 public:
+	static constexpr size_t reassociate_limit = 32;	// factors; the optimizer is cubic
+
 	using smart_ptr = n_ary_op<fp_API>::smart_ptr;
 	using eval_spec = n_ary_op<fp_API>::eval_spec;
 
@@ -24,6 +28,8 @@ public:
 private:
 	void _append_zero(const smart_ptr& src);
 	void _append(smart_ptr&& src);
+	bool _reassociate();
+	bool _self_eval_step();
 
 public:
 	void append_term(const smart_ptr& src);
@@ -42,25 +48,38 @@ public:
 	static bool is_identity(const smart_ptr& x) { return x->is_one(); }
 
 	// fp_API
-	bool self_eval() override;
+	bool self_eval() override { return _rewrite([this] { return _self_eval_step(); }); }
+	std::optional<bool> local_self_eval() override { return _local_rewrite([this] { return _self_eval_step(); }); }
 	bool is_zero() const override;
 	bool is_one() const override;
 	int sgn() const override;
 	bool is_scal_bn_identity() const override { return is_zero(); }	// let evaluation handle this -- pathological behavior anyway
-	intmax_t scal_bn_is_safe(intmax_t scale) const override;
-	intmax_t ideal_scal_bn() const override;
-	const math::type* domain() const override;
+	intmax_t scal_bn_is_safe(intmax_t scale) const override { return this->_properties.scal_bn_is_safe(scale, [&] { return _scal_bn_is_safe(scale); }); }
+	intmax_t ideal_scal_bn() const override { return this->_properties.ideal_scal_bn([this] { return _ideal_scal_bn(); }); }
+	const math::type* domain() const override { return this->_properties.domain([this] { return _domain(); }); }
 	fp_API* clone() const override { return new product(*this); }
 	product* typed_clone() const { return new product(*this); }
 	std::string to_s() const override;
 	int precedence() const override { return _precedence; }
+	size_t arity() const override { return this->_x.size(); }
+	const smart_ptr* term_c(size_t n) const override { return (this->_x.size() > n) ? &this->_x[n] : nullptr; }
+	smart_ptr* term(size_t n) override {
+		this->_changed();
+		return (this->_x.size() > n) ? &this->_x[n] : nullptr;
+	}
+	size_t structural_hash() const override { return this->_properties.structural_hash([this] { return _structural_hash(); }); }
 
 private:
 	static constexpr const auto _precedence = _type_spec::Multiplication;
+	int _sgn() const;
+	intmax_t _scal_bn_is_safe(intmax_t scale) const;
+	intmax_t _ideal_scal_bn() const;
+	const math::type* _domain() const;
+	std::optional<bool> _terms_finite() const;
 	void _scal_bn(intmax_t scale) override;
 	fp_API* _eval() const override { return nullptr; }	// placeholder
 
-	std::optional<bool> _is_finite() const override;
+	std::optional<bool> _is_finite() const override { return this->_properties.is_finite([this] { return _terms_finite(); }); }
 };
 
 } // namespace zaimoni
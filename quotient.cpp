@@ -82,6 +82,12 @@ restart:
 	}
 	case rearrange:
 	{
+		// integer numerals: lowest terms, positive denominator.  Subsumes the scalBn normalization below.
+		if (zaimoni::math::canonical_quotient(_numerator, _denominator)) {
+			would_destructive_eval();
+			return true;
+		}
+
 		// scalBn of denominator towards 1 (arguably normal-form)
 		auto n_scale = _numerator->ideal_scal_bn();
 		auto d_scale = _denominator->ideal_scal_bn();
@@ -241,6 +247,14 @@ const math::type* quotient::domain() const
 	return nullptr;
 }
 
+const quotient::eval_type* quotient::term_c(size_t n) const {
+	switch (n) {
+	case 0: return &_numerator;
+	case 1: return &_denominator;
+	default: return nullptr;
+	}
+}
+
 std::string quotient::to_s() const {
 	auto n = _numerator->to_s();
 	if (_precedence >= _numerator->precedence_to_s()) n = std::string("(") + n + ')';
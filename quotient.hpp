@@ -42,6 +42,9 @@ namespace zaimoni {
 		fp_API* clone() const override { return new quotient(*this); };
 		std::string to_s() const override;
 		int precedence() const override { return _precedence; }
+		size_t arity() const override { return 2; }
+		const eval_type* term_c(size_t n) const override;
+		eval_type* term(size_t n) override { return const_cast<eval_type*>(const_cast<const quotient*>(this)->term_c(n)); }
 
 	private:
 		static constexpr const auto _precedence = _type_spec::Multiplication;
@@ -0,0 +1,476 @@
+#include "serial.hpp"
+#include "intern.hpp"
+#include "sum.hpp"
+#include "product.hpp"
+#include "quotient.hpp"
+#include "power_fp.hpp"
+#include "symbolic_fp.hpp"
+#include "complex.hpp"
+#include "Zaimoni.STL/interval.hpp"
+#include "Zaimoni.STL/var.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace zaimoni {
+
+namespace {
+
+namespace tag {
+	enum : unsigned char {
+		ref = 0,	// u32 index of an earlier shared node
+		leaf,	// fp_leaf, then the value
+		sum,	// u32 arity
+		product,	// u32 arity
+		quotient,
+		power,
+		symbolic,	// i64 scale exponent, u8 flags (1: additive inverse, 2: multiplicative inverse)
+		complex,
+		scaled_sum,	// i64 block exponent, u32 arity
+		shared = 0x80	// flag: later nodes refer back to this one
+	};
+}
+
+template<class T> requires std::is_trivially_copyable_v<T>
+void put(std::string& dest, const T& src) { dest.append(reinterpret_cast<const char*>(&src), sizeof(T)); }
+
+struct reader {
+	std::string_view src;
+
+	template<class T> requires std::is_trivially_copyable_v<T>
+	T get() {
+		if (src.size() < sizeof(T)) throw std::runtime_error("fp_serial: truncated");
+		T ret;
+		std::memcpy(&ret, src.data(), sizeof(T));
+		src.remove_prefix(sizeof(T));
+		return ret;
+	}
+};
+
+// float and double are written as-is.  Wider types may have padding bytes, which would make equal values serialize
+// differently, so they are written as flags (1: negative, 2: infinite, 4: NaN), exponent and mantissa.
+template<std::floating_point F>
+void put_fp(std::string& dest, F src)
+{
+	if constexpr (std::is_same_v<F, float> || std::is_same_v<F, double>) put(dest, src);
+	else {
+		static_assert(std::numeric_limits<F>::digits <= 64);
+		unsigned char flags = std::signbit(src) ? 1 : 0;
+		int32_t e = 0;
+		uint64_t mantissa = 0;
+		if (std::isnan(src)) flags |= 4;
+		else if (std::isinf(src)) flags |= 2;
+		else if (0 != src) {
+			int exponent;
+			mantissa = static_cast<uint64_t>(std::ldexp(std::fabs(std::frexp(src, &exponent)), std::numeric_limits<F>::digits));
+			e = exponent;
+		}
+		put(dest, flags);
+		put(dest, e);
+		put(dest, mantissa);
+	}
+}
+
+template<std::floating_point F>
+F get_fp(reader& src)
+{
+	if constexpr (std::is_same_v<F, float> || std::is_same_v<F, double>) return src.get<F>();
+	else {
+		const auto flags = src.get<unsigned char>();
+		const auto e = src.get<int32_t>();
+		const auto mantissa = src.get<uint64_t>();
+		F ret;
+		if (flags & 4) ret = std::numeric_limits<F>::quiet_NaN();
+		else if (flags & 2) ret = std::numeric_limits<F>::infinity();
+		else ret = std::ldexp(static_cast<F>(mantissa), e - std::numeric_limits<F>::digits);
+		return std::copysign(ret, (flags & 1) ? F(-1) : F(1));
+	}
+}
+
+template<class T>
+void put_value(std::string& dest, const T& src)
+{
+	if constexpr (requires { src.lower(); src.upper(); }) {
+		put_value(dest, src.lower());
+		put_value(dest, src.upper());
+	} else if constexpr (std::is_floating_point_v<T>) put_fp(dest, src);
+	else put(dest, src);
+}
+
+template<class T>
+T get_value(reader& src)
+{
+	if constexpr (requires(T x) { x.lower(); x.upper(); }) {
+		using F = std::remove_cvref_t<decltype(std::declval<T>().lower())>;
+		const auto lb = get_value<F>(src);
+		return T(lb, get_value<F>(src));
+	} else if constexpr (std::is_floating_point_v<T>) return get_fp<T>(src);
+	else return src.get<T>();
+}
+
+template<class T>
+void put_leaf(std::string& dest, const fp_API& src) { put_value(dest, static_cast<const var_fp<T>&>(src)._x); }
+
+template<class T>
+COW<fp_API> get_leaf(reader& src) { return COW<fp_API>(std::in_place_type<var_fp<T> >, get_value<T>(src)); }
+
+uint32_t _u32(size_t src)
+{
+	if (std::numeric_limits<uint32_t>::max() < src) throw std::logic_error("fp_serial: too many terms");
+	return (uint32_t)src;
+}
+
+struct encoder
+{
+	std::string& dest;
+	std::unordered_map<const fp_API*, size_t> uses;
+	std::unordered_map<const fp_API*, uint32_t> emitted;	// shared nodes, by table index
+
+	void count(const fp_API& src) {
+		if (1 < ++uses[&src]) return;
+		const size_t ub = src.arity();
+		for (size_t i = 0; i < ub; ++i) count(*src.term_c(i)->get_c());
+	}
+
+	void emit(const fp_API& src) {
+		if (const auto x = emitted.find(&src); emitted.end() != x) {
+			put(dest, (unsigned char)tag::ref);
+			put(dest, x->second);
+			return;
+		}
+		const size_t ub = src.arity();
+		for (size_t i = 0; i < ub; ++i) emit(*src.term_c(i)->get_c());
+		const unsigned char shared = 1 < uses[&src] ? tag::shared : 0;
+		_emit(src, shared);
+		if (shared) emitted.emplace(&src, _u32(emitted.size()));
+	}
+
+private:
+	void _emit(const fp_API& src, unsigned char shared) {
+		if (const auto leaf = src.leaf_tag(); fp_leaf::none != leaf) {
+			put(dest, (unsigned char)(tag::leaf | shared));
+			put(dest, leaf);
+			switch (leaf) {
+			case fp_leaf::f: return put_leaf<float>(dest, src);
+			case fp_leaf::d: return put_leaf<double>(dest, src);
+			case fp_leaf::ld: return put_leaf<long double>(dest, src);
+			case fp_leaf::s_int: return put_leaf<intmax_t>(dest, src);
+			case fp_leaf::u_int: return put_leaf<uintmax_t>(dest, src);
+			case fp_leaf::interval_f: return put_leaf<ISK_INTERVAL<float> >(dest, src);
+			case fp_leaf::interval_d: return put_leaf<ISK_INTERVAL<double> >(dest, src);
+			case fp_leaf::interval_ld: return put_leaf<ISK_INTERVAL<long double> >(dest, src);
+			default: throw std::logic_error("fp_serial: unknown numeral: " + src.to_s());
+			}
+		}
+		if (const auto x = dynamic_cast<const sum*>(&src)) {
+			if (const auto scale = x->block_exponent()) {
+				put(dest, (unsigned char)(tag::scaled_sum | shared));
+				put(dest, int64_t(scale));
+			} else put(dest, (unsigned char)(tag::sum | shared));
+			put(dest, _u32(src.arity()));
+			return;
+		}
+		if (dynamic_cast<const product*>(&src)) {
+			put(dest, (unsigned char)(tag::product | shared));
+			put(dest, _u32(src.arity()));
+			return;
+		}
+		if (dynamic_cast<const quotient*>(&src)) return put(dest, (unsigned char)(tag::quotient | shared));
+		if (dynamic_cast<const power_fp*>(&src)) return put(dest, (unsigned char)(tag::power | shared));
+		if (const auto x = dynamic_cast<const symbolic_fp*>(&src)) {
+			put(dest, (unsigned char)(tag::symbolic | shared));
+			put(dest, int64_t(x->scale_exponent()));
+			put(dest, (unsigned char)((x->add_inverted() ? 1 : 0) | (x->mult_inverted() ? 2 : 0)));
+			return;
+		}
+		if (dynamic_cast<const math::complex*>(&src)) return put(dest, (unsigned char)(tag::complex | shared));
+		throw std::logic_error("fp_serial: no serialization for " + src.to_s());
+	}
+};
+
+}
+
+void fp_serial::encode(const fp_API& src, std::string& dest)
+{
+	encoder stage{ dest, {}, {} };
+	stage.count(src);
+	stage.emit(src);
+}
+
+COW<fp_API> fp_serial::decode(std::string_view src)
+{
+	reader in{ src };
+	std::vector<COW<fp_API> > stack;
+	std::vector<std::shared_ptr<const fp_API> > table;
+	auto pop = [&]() {
+		if (stack.empty()) throw std::runtime_error("fp_serial: missing term");
+		auto ret(std::move(stack.back()));
+		stack.pop_back();
+		return ret;
+	};
+	auto n_ary = [&](auto* dest) {
+		std::unique_ptr<std::remove_pointer_t<decltype(dest)> > stage(dest);
+		const auto n = in.get<uint32_t>();
+		if (stack.size() < n) throw std::runtime_error("fp_serial: missing term");
+		const auto first = stack.end() - n;
+		for (auto i = first; i != stack.end(); ++i) stage->append_term(std::move(*i));
+		stack.erase(first, stack.end());
+		return COW<fp_API>(static_cast<fp_API*>(stage.release()));
+	};
+
+	while (!in.src.empty()) {
+		const auto code = in.get<unsigned char>();
+		if (tag::ref == code) {
+			const auto n = in.get<uint32_t>();
+			if (table.size() <= n) throw std::runtime_error("fp_serial: bad reference");
+			stack.push_back(COW<fp_API>(table[n]));
+			continue;
+		}
+		COW<fp_API> x;
+		switch (code & ~tag::shared) {
+		case tag::leaf:
+			switch (in.get<fp_leaf>()) {
+			case fp_leaf::f: x = get_leaf<float>(in); break;
+			case fp_leaf::d: x = get_leaf<double>(in); break;
+			case fp_leaf::ld: x = get_leaf<long double>(in); break;
+			case fp_leaf::s_int: x = get_leaf<intmax_t>(in); break;
+			case fp_leaf::u_int: x = get_leaf<uintmax_t>(in); break;
+			case fp_leaf::interval_f: x = get_leaf<ISK_INTERVAL<float> >(in); break;
+			case fp_leaf::interval_d: x = get_leaf<ISK_INTERVAL<double> >(in); break;
+			case fp_leaf::interval_ld: x = get_leaf<ISK_INTERVAL<long double> >(in); break;
+			default: throw std::runtime_error("fp_serial: unknown numeral");
+			}
+			break;
+		case tag::sum:
+			x = n_ary(new sum());
+			break;
+		case tag::product:
+			x = n_ary(new product());
+			break;
+		case tag::scaled_sum: {
+			const auto scale = in.get<int64_t>();
+			x = n_ary(new sum());
+			x->scal_bn(intmax_t(scale));
+			}
+			break;
+		case tag::quotient: {
+			auto d = pop();
+			auto n = pop();
+			x = COW<fp_API>(new quotient(std::move(n), std::move(d)));
+			}
+			break;
+		case tag::power: {
+			auto e = pop();
+			auto b = pop();
+			x = COW<fp_API>(new power_fp(std::move(b), std::move(e)));
+			}
+			break;
+		case tag::symbolic: {
+			const auto scale = in.get<int64_t>();
+			const auto flags = in.get<unsigned char>();
+			auto stage = new symbolic_fp(pop(), intmax_t(scale));
+			if (flags & 1) stage->self_negate();
+			if (flags & 2) stage->self_multinv();
+			x = COW<fp_API>(static_cast<fp_API*>(stage));
+			}
+			break;
+		case tag::complex: {
+			auto im = pop();
+			auto re = pop();
+			x = COW<fp_API>(new math::complex(std::move(re), std::move(im)));
+			}
+			break;
+		default: throw std::runtime_error("fp_serial: unknown node");
+		}
+		if (code & tag::shared) table.push_back(x.share());
+		stack.push_back(std::move(x));
+	}
+	if (1 != stack.size()) throw std::runtime_error("fp_serial: not one expression");
+	return std::move(stack.front());
+}
+
+uint64_t fp_serial::fingerprint(std::string_view src)
+{
+	uint64_t ret = 0xcbf29ce484222325ULL;
+	for (const unsigned char c : src) {
+		ret ^= c;
+		ret *= 0x100000001b3ULL;
+	}
+	return ret;
+}
+
+// memo file layout: file_header, then count index_entry sorted by key, then the serialized data
+namespace {
+
+struct file_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t reserved;
+	uint64_t count;
+};
+
+struct index_entry {
+	uint64_t key;
+	uint64_t offset;	// of the input; the result follows it
+	uint32_t input_size;
+	uint32_t result_size;
+};
+
+constexpr char memo_magic[4] = { 'I', 'S', 'K', 'M' };
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+template<class T> T read_at(const std::vector<char>& src, size_t offset)
+{
+	T ret;
+	std::memcpy(&ret, src.data() + offset, sizeof(T));
+	return ret;
+}
+
+index_entry read_entry(const std::vector<char>& src, size_t n) { return read_at<index_entry>(src, sizeof(file_header) + n * sizeof(index_entry)); }
+
+bool valid_image(const std::vector<char>& src)
+{
+	if (src.size() < sizeof(file_header)) return false;
+	const auto header = read_at<file_header>(src, 0);
+	if (0 != std::memcmp(header.magic, memo_magic, sizeof(memo_magic))) return false;
+	if (fp_memo_file::version != header.version || byte_order_mark != header.byte_order) return false;
+	if ((src.size() - sizeof(file_header)) / sizeof(index_entry) < header.count) return false;
+	uint64_t prev_key = 0;
+	for (size_t i = 0; i < header.count; ++i) {
+		const auto x = read_entry(src, i);
+		if (x.key < prev_key) return false;
+		if (src.size() < x.offset || src.size() - x.offset < uint64_t(x.input_size) + x.result_size) return false;
+		prev_key = x.key;
+	}
+	return true;
+}
+
+}
+
+fp_memo_file::fp_memo_file(std::filesystem::path src) : _path(std::move(src))
+{
+	std::ifstream in(_path, std::ios::binary | std::ios::ate);
+	if (!in) return;
+	const auto n = in.tellg();
+	if (0 >= n) return;
+	in.seekg(0);
+	_image.resize(size_t(n));
+	if (!in.read(_image.data(), n) || !valid_image(_image)) _image.clear();
+}
+
+size_t fp_memo_file::size() const
+{
+	const size_t loaded = _image.empty() ? 0 : read_at<file_header>(_image, 0).count;
+	return loaded + _added.size();
+}
+
+std::string_view fp_memo_file::_lookup(uint64_t key, std::string_view input) const
+{
+	if (!_image.empty()) {
+		const size_t ub = read_at<file_header>(_image, 0).count;
+		size_t lb = 0;
+		size_t strict_ub = ub;
+		while (lb < strict_ub) {
+			const size_t mid = lb + (strict_ub - lb) / 2;
+			if (read_entry(_image, mid).key < key) lb = mid + 1;
+			else strict_ub = mid;
+		}
+		for (; lb < ub; ++lb) {
+			const auto x = read_entry(_image, lb);
+			if (key != x.key) break;
+			if (input == std::string_view(_image.data() + x.offset, x.input_size)) return std::string_view(_image.data() + x.offset + x.input_size, x.result_size);
+		}
+	}
+	if (const auto x = _added.find(key); _added.end() != x && x->second.first == input) return x->second.second;
+	return std::string_view();
+}
+
+bool fp_memo_file::eval(COW<fp_API>& x)
+{
+	if (!x) return false;
+	fp_intern::intern(x);
+	std::string input;
+	try {
+		fp_serial::encode(*x.get_c(), input);
+	} catch (const std::logic_error&) {	// not serializable: evaluate as usual
+		bool ret = false;
+		while (fp_API::eval(x)) ret = true;
+		return ret;
+	}
+
+	++_stats.lookups;
+	const auto key = fp_serial::fingerprint(input);
+	if (const auto cached = _lookup(key, input); !cached.empty()) {
+		try {
+			auto result = fp_serial::decode(cached);
+			++_stats.hits;
+			if (cached == input) return false;
+			x = std::move(result);
+			return true;
+		} catch (const std::runtime_error&) {}	// damaged entry: recompute
+	}
+
+	bool ret = false;
+	while (fp_API::eval(x)) ret = true;
+	try {
+		auto result = fp_serial::encode(*x.get_c());
+		if (std::numeric_limits<uint32_t>::max() >= input.size() && std::numeric_limits<uint32_t>::max() >= result.size()) {
+			_added.insert_or_assign(key, std::pair(std::move(input), std::move(result)));
+			++_stats.misses_stored;
+		}
+	} catch (const std::logic_error&) {}
+	return ret;
+}
+
+bool fp_memo_file::save()
+{
+	struct entry {
+		uint64_t key;
+		std::string_view input;
+		std::string_view result;
+	};
+
+	std::vector<entry> entries;
+	if (!_image.empty()) {
+		const size_t ub = read_at<file_header>(_image, 0).count;
+		for (size_t i = 0; i < ub; ++i) {
+			const auto x = read_entry(_image, i);
+			entries.push_back(entry{ x.key, std::string_view(_image.data() + x.offset, x.input_size), std::string_view(_image.data() + x.offset + x.input_size, x.result_size) });
+		}
+	}
+	for (const auto& x : _added) entries.push_back(entry{ x.first, x.second.first, x.second.second });
+	std::stable_sort(entries.begin(), entries.end(), [](const entry& lhs, const entry& rhs) { return lhs.key < rhs.key; });
+
+	file_header header = { {}, version, byte_order_mark, 0, entries.size() };
+	std::memcpy(header.magic, memo_magic, sizeof(memo_magic));
+	std::string out;
+	put(out, header);
+	uint64_t offset = sizeof(file_header) + entries.size() * sizeof(index_entry);
+	for (const auto& x : entries) {
+		put(out, index_entry{ x.key, offset, uint32_t(x.input.size()), uint32_t(x.result.size()) });
+		offset += x.input.size() + x.result.size();
+	}
+	for (const auto& x : entries) {
+		out.append(x.input);
+		out.append(x.result);
+	}
+
+	auto stage(_path);
+	stage += ".tmp";
+	{
+	std::ofstream dest(stage, std::ios::binary | std::ios::trunc);
+	if (!dest.write(out.data(), out.size()) || !dest.flush()) return false;
+	}
+	std::error_code err;
+	std::filesystem::rename(stage, _path, err);
+	if (err) return false;
+	_image.assign(out.begin(), out.end());
+	_added.clear();
+	return true;
+}
+
+}	// namespace zaimoni
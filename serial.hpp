@@ -0,0 +1,78 @@
+#ifndef SERIAL_HPP
+#define SERIAL_HPP 1
+
+#include "Zaimoni.STL/eval.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace zaimoni {
+
+// compact binary form of fp_API expression trees: numeral leaves, sum, product, quotient, power_fp, symbolic_fp and
+// math::complex.  Nodes are written in post-order; a node that appears more than once (by address) is written once
+// and referenced after that, so shared subtrees stay shared when read back.  Native byte order.
+class fp_serial final
+{
+public:
+	fp_serial() = delete;
+
+	// throws std::logic_error for node types that have no serialization
+	static void encode(const fp_API& src, std::string& dest);	// appends
+	static std::string encode(const fp_API& src) {
+		std::string ret;
+		encode(src, ret);
+		return ret;	// trigger NRVO
+	}
+	// throws std::runtime_error for malformed input
+	static COW<fp_API> decode(std::string_view src);
+
+	static uint64_t fingerprint(std::string_view src);	// FNV-1a; unlike std::hash, stable from run to run
+};
+
+// persistent memo of fp_API::eval to a fixed point, keyed by the serialized input.  The file is a header, an index
+// sorted by key, and the serialized (input, result) pairs; it is looked up in place, without parsing, so it may as
+// well be memory-mapped.  A missing, foreign or damaged file is an empty cache.
+class fp_memo_file final
+{
+public:
+	struct stats {
+		size_t lookups = 0;
+		size_t hits = 0;
+		size_t misses_stored = 0;	// results not serializable are not stored
+	};
+
+	static constexpr uint32_t version = 1;
+
+private:
+	std::filesystem::path _path;
+	std::vector<char> _image;	// the file as loaded; empty if invalid
+	std::unordered_map<uint64_t, std::pair<std::string, std::string> > _added;	// since loading
+	stats _stats;
+
+public:
+	explicit fp_memo_file(std::filesystem::path src);
+	fp_memo_file(const fp_memo_file& src) = delete;
+	fp_memo_file(fp_memo_file&& src) = default;
+	~fp_memo_file() = default;
+	fp_memo_file& operator=(const fp_memo_file& src) = delete;
+	fp_memo_file& operator=(fp_memo_file&& src) = default;
+
+	// memoized equivalent of while(fp_API::eval(x));  Interns x (see fp_intern), so that equal subtrees are shared
+	// and the key does not depend on how x was built.
+	bool eval(COW<fp_API>& x);
+
+	size_t size() const;
+	bool dirty() const { return !_added.empty(); }
+	const stats& statistics() const { return _stats; }
+	bool save();	// writes the merged cache, replacing the file; false on I/O failure
+
+private:
+	std::string_view _lookup(uint64_t key, std::string_view input) const;	// empty if not found
+};
+
+}	// namespace zaimoni
+
+#endif
@@ -4,21 +4,34 @@
 #define SERIES_SUM_HPP 1
 
 #include "overprecise.hpp"
+#include "superaccumulator.hpp"
 #include <vector>
 #include <algorithm>
 
 namespace zaimoni {
 namespace math {
 
+template<class T> struct series_sum_exact {
+	struct type {};
+};
+
+template<std::floating_point T> requires requires() { superaccumulator<T>(); }
+struct series_sum_exact<T> {
+	using type = superaccumulator<T>;
+};
+
 template<class T>
 class series_sum
 {
 private:
+	static constexpr bool is_exact = !std::is_empty_v<typename series_sum_exact<T>::type>;
+
 	std::vector<T> _x;	// XXX not appropriate for self-destructive evaluation
+	typename series_sum_exact<T>::type _exact;	// finite floating-point terms; _x then only holds an infinity
 public:
 	series_sum() = default;
-	series_sum(const std::vector<T>& src) : _x(src) {};
-	series_sum(std::vector<T>&& src) : _x(src) {};
+	series_sum(const std::vector<T>& src) : _x(src) { _absorb(); };
+	series_sum(std::vector<T>&& src) : _x(src) { _absorb(); };
 	ZAIMONI_DEFAULT_COPY_DESTROY_ASSIGN(series_sum);
 
 	void push_back(T src)
@@ -29,33 +42,45 @@ public:
 #ifdef ZAIMONI_USING_STACKTRACE
 		zaimoni::ref_stack<zaimoni::stacktrace, const char*> log(zaimoni::stacktrace::get(), __PRETTY_FUNCTION__);
 #endif
-		const bool no_further_op = _x.empty();
-		if (!no_further_op) {
-			const bool was_finite = isFinite(_x.front());
-			const int code = trivial_sum(_x.front(),src);
-			if (-1==code) _x.front() = src;
-			if (was_finite && !isFinite(_x.front()))
-				{
-				size_t i = _x.size();
-				size_t ub = i-1;
-				T* _raw = _x.data();
-				while(1 <= --i)
-					switch(trivial_sum(_raw[0],_raw[i]))
+		if constexpr (is_exact) {	// linear time: no rearranging
+			if (!_x.empty()) {
+				trivial_sum(_x.front(), src);	// throws on infinity-infinity
+				return;
+			}
+			if (isFinite(src)) _exact.push_back(src);
+			else {
+				_exact.clear();
+				_x.push_back(src);
+			}
+		} else {
+			const bool no_further_op = _x.empty();
+			if (!no_further_op) {
+				const bool was_finite = isFinite(_x.front());
+				const int code = trivial_sum(_x.front(),src);
+				if (-1==code) _x.front() = src;
+				if (was_finite && !isFinite(_x.front()))
 					{
-					case -1: swap(_raw[0],_raw[i]);
-					// intentional fall-through
-					case 1: if (i<ub) swap(_raw[i],_raw[ub]);
-						ub--;
-						break;						
-					default: break;
+					size_t i = _x.size();
+					size_t ub = i-1;
+					T* _raw = _x.data();
+					while(1 <= --i)
+						switch(trivial_sum(_raw[0],_raw[i]))
+						{
+						case -1: swap(_raw[0],_raw[i]);
+						// intentional fall-through
+						case 1: if (i<ub) swap(_raw[i],_raw[ub]);
+							ub--;
+							break;						
+						default: break;
+						}
+					++ub;
+					if (ub<_x.size()) _x.resize(ub);
 					}
-				++ub;
-				if (ub<_x.size()) _x.resize(ub);
-				}
-			if (code) return;
+				if (code) return;
+			}
+			_x.push_back(src);
+			if (!no_further_op) _rearrange_sum();
 		}
-		_x.push_back(src);
-		if (!no_further_op) _rearrange_sum();
 	};
 
 	// also want: self-destructive version
@@ -64,19 +89,34 @@ public:
 #ifdef ZAIMONI_USING_STACKTRACE
 		zaimoni::ref_stack<zaimoni::stacktrace, const char*> log(zaimoni::stacktrace::get(), __PRETTY_FUNCTION__);
 #endif
-		switch(_x.size())
-		{
-		case 0: return int_as<0,typename interval_type<T>::type >();
-		case 1: return _x.front();
-		case 2: break;
-		default: std::stable_sort(_x.begin(),_x.end(), fp_compare<T>::good_sum_lt); break;	// sort in strictly increasing exponent order
-		};
-		typename interval_type<T>::type ret(int_as<0, typename interval_type<T>::type>());
-		for (auto i : _x) ret += i;
-		return ret;
+		if constexpr (is_exact) {	// rounded once
+			if (!_x.empty()) return _x.front();
+			const auto bounds = _exact.bounds();
+			return typename interval_type<T>::type(bounds.first, bounds.second);
+		} else {
+			switch(_x.size())
+			{
+			case 0: return int_as<0,typename interval_type<T>::type >();
+			case 1: return _x.front();
+			case 2: break;
+			default: std::stable_sort(_x.begin(),_x.end(), fp_compare<T>::good_sum_lt); break;	// sort in strictly increasing exponent order
+			};
+			typename interval_type<T>::type ret(int_as<0, typename interval_type<T>::type>());
+			for (auto i : _x) ret += i;
+			return ret;
+		}
 	}
 
 private:
+	void _absorb()
+	{
+		if constexpr (is_exact) {
+			std::vector<T> src;
+			swap(src, _x);
+			for (const auto x : src) push_back(x);
+		}
+	}
+
 	void _rearrange_sum()
 	{
 		assert(2 <= _x.size());
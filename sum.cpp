@@ -1,42 +1,200 @@
 #include "sum.hpp"
 #include "arithmetic.hpp"
+#include "superaccumulator.hpp"
+#include "symbolic_fp.hpp"
+#include "Zaimoni.STL/var.hpp"
 #include "Zaimoni.STL/numeric_error.hpp"
 #include "Zaimoni.STL/Logging.h"
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
 
 namespace zaimoni {
 
 // external inference rule support
-std::vector<sum::rule_guard> sum::eval_ok;
-std::vector<sum::eval_rule_spec> sum::eval_algebraic_rules;
-std::vector<sum::eval_rule_spec> sum::eval_inexact_rules;
 
-#define GUARDED_APPEND(DEST, SRC) \
-	do {if (DEST.end() == std::ranges::find(DEST, SRC)) DEST.push_back(SRC);} while(0)
+// profiling counters, one per guard and rule (std::deque: atomics cannot be relocated)
+namespace {
 
-void sum::eval_algebraic_rule(const eval_rule_spec& src)
+struct guard_counters {
+	std::atomic<size_t> calls{0};
+	std::atomic<size_t> hits{0};
+};
+
+struct rule_counters {
+	const char* const name;
+	std::atomic<size_t> tests{0};
+	std::atomic<size_t> matches{0};
+	std::atomic<size_t> fires{0};
+	std::atomic<std::chrono::nanoseconds::rep> eval_time{0};
+
+	explicit rule_counters(const char* src) : name(src) {}
+
+	bool test(sum::would_eval f, const std::any& lhs, const std::any& rhs) {
+		tests.fetch_add(1, std::memory_order_relaxed);
+		if (!f(lhs, rhs)) return false;
+		matches.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	fp_API* eval(sum::rule_eval f, const eval_to_ptr<fp_API>::eval_type& lhs, const eval_to_ptr<fp_API>::eval_type& rhs) {
+		const auto start = std::chrono::steady_clock::now();
+		fp_API* const ret = f(lhs, rhs);
+		eval_time.fetch_add((std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+		if (ret) fires.fetch_add(1, std::memory_order_relaxed);
+		return ret;
+	}
+
+	void reset() {
+		tests = 0;
+		matches = 0;
+		fires = 0;
+		eval_time = 0;
+	}
+};
+
+}
+
+// The registry is read without locking.  Registration is serialized, and publishes a new immutable table rather than
+// modifying the current one; superseded tables are kept, so a table being read is never freed.  Registration is
+// append-only, so guard indices are the same in every table.
+struct sum::rule_table {
+	struct rule {
+		eval_rule_spec spec;
+		size_t lhs_guard;	// index into guards
+		size_t rhs_guard;
+		rule_counters* profile;
+	};
+
+	std::vector<rule_guard> guards;
+	std::vector<guard_counters*> guard_profile;
+	std::vector<rule> algebraic;
+	std::vector<rule> inexact;
+};
+
+static std::mutex registry_lock;	// for everything below
+static std::deque<sum::rule_table> rule_tables(1);	// never shrinks
+static std::deque<guard_counters> guard_profile;
+static std::deque<rule_counters> algebraic_profile;
+static std::deque<rule_counters> inexact_profile;
+static std::atomic<const sum::rule_table*> current_rules = &rule_tables.front();
+static std::atomic<bool> rules_are_frozen = false;
+
+const sum::rule_table& sum::rules() { return *current_rules.load(std::memory_order_acquire); }
+
+static size_t guard_index(sum::rule_table& dest, sum::rule_guard src)
 {
-	if (!src.second.second) return;
-	if (!src.second.first) return;
-	if (!src.first.second) return;
-	if (!src.first.first) return;
-	GUARDED_APPEND(eval_ok, src.first.first);
-	GUARDED_APPEND(eval_ok, src.first.second);
-	GUARDED_APPEND(eval_algebraic_rules, src);
+	const size_t ret = std::ranges::find(dest.guards, src) - dest.guards.begin();
+	if (dest.guards.size() == ret) {
+		dest.guards.push_back(src);
+		dest.guard_profile.push_back(&guard_profile.emplace_back());
+	}
+	return ret;
 }
 
-void sum::eval_inexact_rule(const eval_rule_spec& src)
+// does nothing if src is already registered
+static void register_rule(std::vector<sum::rule_table::rule> sum::rule_table::* kind, std::deque<rule_counters>& profile, const sum::eval_rule_spec& src, const char* name)
 {
 	if (!src.second.second) return;
 	if (!src.second.first) return;
 	if (!src.first.second) return;
 	if (!src.first.first) return;
-	GUARDED_APPEND(eval_ok, src.first.first);
-	GUARDED_APPEND(eval_ok, src.first.second);
-	GUARDED_APPEND(eval_inexact_rules, src);
+	std::lock_guard lock(registry_lock);
+	const auto& rules = rule_tables.back();
+	if ((rules.*kind).end() != std::ranges::find(rules.*kind, src, &sum::rule_table::rule::spec)) return;
+	if (rules_are_frozen) throw std::logic_error("sum: rule registered after the registry was frozen");
+	auto stage(rules);
+	const auto lhs = guard_index(stage, src.first.first);
+	const auto rhs = guard_index(stage, src.first.second);
+	(stage.*kind).push_back({ src, lhs, rhs, &profile.emplace_back(name) });
+	current_rules.store(&rule_tables.emplace_back(std::move(stage)), std::memory_order_release);
+}
+
+void sum::eval_algebraic_rule(const eval_rule_spec& src, const char* name) { register_rule(&rule_table::algebraic, algebraic_profile, src, name); }
+void sum::eval_inexact_rule(const eval_rule_spec& src, const char* name) { register_rule(&rule_table::inexact, inexact_profile, src, name); }
+
+void sum::freeze_rules()
+{
+	symbolic_fp::global_init();	// built-in rules
+	rules_are_frozen = true;
+}
+
+bool sum::rules_frozen() { return rules_are_frozen; }
+
+static std::vector<sum::rule_stats> rule_profile(const std::vector<sum::rule_table::rule>& rules, const std::vector<guard_counters*>& guards)
+{
+	std::vector<sum::rule_stats> ret;
+	ret.reserve(rules.size());
+	for (decltype(auto) x : rules) {
+		const auto& src = *x.profile;
+		sum::rule_stats stage = { src.name, 0, 0, src.tests, src.matches, src.fires, std::chrono::nanoseconds(src.eval_time) };
+		stage.guard_calls = guards[x.lhs_guard]->calls;
+		stage.guard_hits = guards[x.lhs_guard]->hits;
+		if (x.lhs_guard != x.rhs_guard) {
+			stage.guard_calls += guards[x.rhs_guard]->calls;
+			stage.guard_hits += guards[x.rhs_guard]->hits;
+		}
+		ret.push_back(stage);
+	}
+	return ret;
+}
+
+std::vector<sum::rule_stats> sum::algebraic_rule_stats() { return rule_profile(rules().algebraic, rules().guard_profile); }
+std::vector<sum::rule_stats> sum::inexact_rule_stats() { return rule_profile(rules().inexact, rules().guard_profile); }
+
+void sum::reset_rule_stats()
+{
+	std::lock_guard lock(registry_lock);
+	for (decltype(auto) x : guard_profile) {
+		x.calls = 0;
+		x.hits = 0;
+	}
+	for (decltype(auto) x : algebraic_profile) x.reset();
+	for (decltype(auto) x : inexact_profile) x.reset();
+}
+
+static void report_rule_stats(const char* kind, const std::vector<sum::rule_stats>& src)
+{
+	for (size_t i = 0; i < src.size(); ++i) {
+		const auto& x = src[i];
+		INC_INFORM("sum rule ");
+		INC_INFORM(kind);
+		INC_INFORM(" ");
+		if (x.name) INC_INFORM(x.name);
+		else {
+			INC_INFORM("#");
+			INC_INFORM(i);
+		}
+		INC_INFORM(": guard hits ");
+		INC_INFORM(x.guard_hits);
+		INC_INFORM("/");
+		INC_INFORM(x.guard_calls);
+		INC_INFORM(", matches ");
+		INC_INFORM(x.matches);
+		INC_INFORM("/");
+		INC_INFORM(x.tests);
+		INC_INFORM(", fired ");
+		INC_INFORM(x.fires);
+		INC_INFORM(", ");
+		INC_INFORM(x.eval_time.count());
+		INFORM("ns");
+	}
+}
+
+void sum::report_rules()
+{
+	report_rule_stats("algebraic", algebraic_rule_stats());
+	report_rule_stats("inexact", inexact_rule_stats());
 }
 
-#undef GUARDED_APPEND
+void sum::report_rules_at_exit()
+{
+	static std::once_flag registered;
+	std::call_once(registered, [] { std::atexit(report_rules); });
+}
 
 // \todo allow domain upgrade
 bool sum::_append_infinity(const smart_ptr& src) {
@@ -58,8 +216,22 @@ bool sum::_append_infinity(const smart_ptr& src) {
 
 void sum::_append(smart_ptr&& src)
 {
-	if (src->is_inf() && !_append_infinity(src)) return;	// mostly an annihilator
-	this->_append_term(src);
+	this->_changed();
+	if (src.get_c()->is_inf() && !_append_infinity(src)) return;	// mostly an annihilator
+	if (0 != _scale) _scale_term(src, -_scale);	// -INTMAX_MIN excluded by scal_bn_is_safe
+	this->_append_term(std::move(src));
+}
+
+// exact: what the term cannot absorb is kept symbolically
+void sum::_scale_term(smart_ptr& x, intmax_t scale)
+{
+	if (x.get_c()->is_scal_bn_identity()) return;
+	const auto safe = x.get_c()->scal_bn_is_safe(scale);
+	if (0 != safe) {
+		x->scal_bn(safe);
+		if (0 == (scale -= safe)) return;
+	}
+	x = smart_ptr(new symbolic_fp(std::move(x), scale));
 }
 
 void sum::append_term(const smart_ptr& src) {
@@ -69,15 +241,40 @@ void sum::append_term(const smart_ptr& src) {
 }
 
 void sum::append_term(smart_ptr&& src) {
-	if (!src || src->is_zero()) return;
-	assert(src->domain());
+	if (!src || src.get_c()->is_zero()) return;	// non-const access would unshare src
+	assert(src.get_c()->domain());
 	_append(std::move(src));
 }
 
+const std::any& sum::_guard(const rule_table& rules, size_t rule_index, size_t term_hash, const smart_ptr& x)
+{
+	auto& memo = _guard_cache[x.get_c()];
+	if (memo.term_hash != term_hash) {
+		memo.term_hash = term_hash;
+		memo.result.clear();
+	}
+	if (memo.result.size() <= rule_index) memo.result.resize(rules.guards.size());
+	auto& ret = memo.result[rule_index];
+	if (!ret) {
+		ret = rules.guards[rule_index](x);
+		auto& profile = *rules.guard_profile[rule_index];
+		profile.calls.fetch_add(1, std::memory_order_relaxed);
+		if (ret->has_value()) profile.hits.fetch_add(1, std::memory_order_relaxed);
+	}
+	return *ret;
+}
+
 bool sum::would_fpAPI_eval() const { return 1 >= this->_x.size(); }
 
 sum::eval_type sum::destructive_eval() {
-	if (1 == this->_x.size()) return std::move(this->_x.front());
+	if (1 == this->_x.size()) {
+		this->_changed();
+		if (0 != _scale) {
+			_scale_term(this->_x.front(), _scale);
+			_scale = 0;
+		}
+		return std::move(this->_x.front());
+	}
 	return nullptr;
 }
 
@@ -93,7 +290,7 @@ static void apply_eval(std::vector<eval_to_ptr<fp_API>::eval_type>& dest, std::u
 
 }
 
-bool sum::algebraic_self_eval() {
+bool sum::_algebraic_self_eval_step() {
 	// flush removal of identity from prior implementation
 	bool ret = false;
 	while(!_heuristic.empty()) {
@@ -114,25 +311,42 @@ bool sum::algebraic_self_eval() {
 	}
 	if (ret) return true;
 
-	if (eval_algebraic_rules.empty()) return false;
+	const auto& rules = sum::rules();
+	if (rules.algebraic.empty()) return false;
+
+	// guards only re-run on terms whose structure changed since they were last seen.  Sums and products cache their
+	// hash, so this does not walk the whole tree.
+	std::vector<std::pair<const fp_API*, size_t> > terms;
+	terms.reserve(_x.size());
+	for (decltype(auto) x : _x) terms.push_back(std::pair(x.get_c(), x.get_c()->structural_hash()));
+	if (terms != _interpreted_terms) {
+		_interpreted.clear();
+		_interpreted_terms = std::move(terms);
+		if (_guard_cache.size() > 2 * _x.size()) {
+			std::unordered_set<const fp_API*> live;
+			for (decltype(auto) x : _x) live.insert(x.get_c());
+			std::erase_if(_guard_cache, [&](const auto& entry) { return !live.contains(entry.first); });
+		}
+	}
 
-	std::map<size_t, std::vector<std::pair<ptrdiff_t, std::any> > > interpreted; // interesting candidate for cache
 	// effective iteration order...rule, lhs index, rhs_index
-	for (decltype(auto) rule : eval_algebraic_rules) {
-		const auto lhs_rule_index = std::ranges::find(eval_ok, rule.first.first) - eval_ok.begin();
-		const auto rhs_rule_index = std::ranges::find(eval_ok, rule.first.second) - eval_ok.begin();
-		auto lhs_args = interpreted.find(lhs_rule_index);
-		if (interpreted.end() == lhs_args) {
-			decltype(interpreted.begin()->second) staging;
+	for (decltype(auto) x : rules.algebraic) {
+		const auto& rule = x.spec;
+		auto& profile = *x.profile;
+		const auto lhs_rule_index = x.lhs_guard;
+		const auto rhs_rule_index = x.rhs_guard;
+		auto lhs_args = _interpreted.find(lhs_rule_index);
+		if (_interpreted.end() == lhs_args) {
+			decltype(_interpreted.begin()->second) staging;
 			const auto origin = _x.begin();
 			const auto end = _x.end();
 			auto iter = _x.begin();
 			do {
-				auto test = rule.first.first(*iter);
+				const auto& test = _guard(rules, lhs_rule_index, _interpreted_terms[iter - origin].second, *iter);
 				if (test.has_value()) staging.push_back(std::pair(iter - origin, test));
 			} while (end != ++iter);
-			interpreted[lhs_rule_index] = std::move(staging);
-			lhs_args = interpreted.find(lhs_rule_index);
+			_interpreted[lhs_rule_index] = std::move(staging);
+			lhs_args = _interpreted.find(lhs_rule_index);
 		}
 		auto& lhs_seen = lhs_args->second;
 		if (lhs_seen.empty()) continue;
@@ -141,8 +355,8 @@ bool sum::algebraic_self_eval() {
 				ptrdiff_t anchor = lhs_seen.size() - 1;
 				auto pivot = anchor - 1;
 				do {
-					if (rule.second.first(lhs_seen[pivot].second, lhs_seen[anchor].second)) {
-						auto stage = std::unique_ptr<fp_API>(rule.second.second(_x[lhs_seen[pivot].first], _x[lhs_seen[anchor].first]));
+					if (profile.test(rule.second.first, lhs_seen[pivot].second, lhs_seen[anchor].second)) {
+						auto stage = std::unique_ptr<fp_API>(profile.eval(rule.second.second, _x[lhs_seen[pivot].first], _x[lhs_seen[anchor].first]));
 						if (!stage) continue;
 						apply_eval(_x, stage, lhs_seen[pivot].first, lhs_seen[anchor].first);
 						// \todo better backpatch; this is a hard reset
@@ -153,18 +367,18 @@ bool sum::algebraic_self_eval() {
 				} while (0 <= --pivot);
 			}
 		} else {
-			auto rhs_args = (lhs_rule_index == rhs_rule_index) ? lhs_args : interpreted.find(rhs_rule_index);
-			if (interpreted.end() == rhs_args) {
-				decltype(interpreted.begin()->second) staging;
+			auto rhs_args = (lhs_rule_index == rhs_rule_index) ? lhs_args : _interpreted.find(rhs_rule_index);
+			if (_interpreted.end() == rhs_args) {
+				decltype(_interpreted.begin()->second) staging;
 				const auto origin = _x.begin();
 				const auto end = _x.end();
 				auto iter = _x.begin();
 				do {
-					auto test = rule.first.second(*iter);
+					const auto& test = _guard(rules, rhs_rule_index, _interpreted_terms[iter - origin].second, *iter);
 					if (test.has_value()) staging.push_back(std::pair(iter - origin, test));
 				} while (end != ++iter);
-				interpreted[rhs_rule_index] = std::move(staging);
-				rhs_args = interpreted.find(rhs_rule_index);
+				_interpreted[rhs_rule_index] = std::move(staging);
+				rhs_args = _interpreted.find(rhs_rule_index);
 			}
 			auto& rhs_seen = rhs_args->second;
 			if (!lhs_seen.empty() && !rhs_seen.empty()) {
@@ -172,8 +386,8 @@ bool sum::algebraic_self_eval() {
 				do {
 					auto pivot = lhs_seen.size() - 1;
 					do {
-						if (rule.second.first(lhs_seen[pivot].second, rhs_seen[anchor].second)) {
-							auto stage = std::unique_ptr<fp_API>(rule.second.second(_x[lhs_seen[pivot].first], _x[rhs_seen[anchor].first]));
+						if (profile.test(rule.second.first, lhs_seen[pivot].second, rhs_seen[anchor].second)) {
+							auto stage = std::unique_ptr<fp_API>(profile.eval(rule.second.second, _x[lhs_seen[pivot].first], _x[rhs_seen[anchor].first]));
 							if (!stage) continue;
 							apply_eval(_x, stage, lhs_seen[pivot].first, rhs_seen[anchor].first);
 							// \todo better backpatch; this is a hard reset
@@ -189,8 +403,44 @@ bool sum::algebraic_self_eval() {
 	return false;
 }
 
-bool sum::self_eval() {
+// replaces the finite F leaves, if there are enough of them, with their exact total as non-overlapping F values
+template<std::floating_point F>
+static bool exact_sum(std::vector<eval_to_ptr<fp_API>::eval_type>& x)
+{
+	if constexpr (std::numeric_limits<F>::digits <= 64) {
+		std::vector<size_t> leaves;
+		for (size_t i = 0; i < x.size(); ++i) {
+			const auto src = x[i].get_c();
+			if (fp_leaf_tag<F>::value == src->leaf_tag() && std::isfinite(static_cast<const var_fp<F>*>(src)->_x)) leaves.push_back(i);
+		}
+		if (sum::exact_threshold > leaves.size()) return false;
+		math::superaccumulator<F> total;
+		for (const auto i : leaves) total.push_back(static_cast<const var_fp<F>*>(x[i].get_c())->_x);
+		const auto terms = total.expansion();
+		if (!terms || terms->size() >= leaves.size()) return false;
+		for (size_t n = leaves.size(); 0 < n--; ) x.erase(x.begin() + leaves[n]);
+		for (const auto t : *terms) x.push_back(eval_to_ptr<fp_API>::eval_type(std::in_place_type<var_fp<F> >, t));
+		return true;
+	} else return false;
+}
+
+bool sum::_exact_self_eval()
+{
+	if (exact_threshold > _x.size() || _exact_seen == this->_changes) return false;
+	bool ret = exact_sum<float>(_x);
+	if (exact_sum<double>(_x)) ret = true;
+	if (exact_sum<long double>(_x)) ret = true;
+	_exact_seen = this->_changes;
+	if (!ret) return false;
+	_heuristic.clear();
+	_heuristic.push_back(eval_spec(_n_ary_op::linear_scan, 1));
+	return true;
+}
+
+bool sum::_self_eval_step() {
 	if (!this->_pre_self_eval()) return false;
+	if (this->_parallel_self_eval()) return true;
+	if (this->_exact_self_eval()) return true;
 	if (this->_self_eval(zaimoni::math::rearrange_sum, zaimoni::math::sum_score, zaimoni::math::sum_score, zaimoni::math::eval_sum)) return true;
 	//	auto& checking = this->_heuristic.back();
 	// \todo process our specific rules
@@ -205,11 +455,16 @@ bool sum::is_zero() const {
 }
 
 bool sum::is_one() const {
-	if (1 == this->_x.size()) return this->_x.front()->is_one();
+	if (1 == this->_x.size() && 0 == _scale) return this->_x.front()->is_one();
 	return false;
 }
 
 int sum::sgn() const {
+	if (const auto ret = this->_properties.sgn([this] { return _sgn(); })) return *ret;
+	throw zaimoni::math::numeric_error("sum needs to evaluate enough to calculate sgn()");
+}
+
+std::optional<int> sum::_sgn() const {
 	if (is_zero()) return 0;
 	unsigned int seen = 0;
 	for (auto& x : this->_x) {
@@ -220,27 +475,31 @@ int sum::sgn() const {
 	if (0 == seen) return 0;
 	if (4 == seen) return 1;	// only saw positive
 	if (1 == seen) return -1;	// only saw negative
-	// anything else would need evaluation to get right
-	throw zaimoni::math::numeric_error("sum needs to evaluate enough to calculate sgn()");
+	return std::nullopt;	// would need evaluation to get right
 }
 
+// the block exponent takes any scale that it can represent; the terms need not be consulted
 intmax_t sum::scal_bn_is_safe(intmax_t scale) const
 {
-restart:
-	for (const auto& x : this->_x) {
-		if (x->is_scal_bn_identity()) continue;
-		intmax_t test = x->scal_bn_is_safe(scale);
-		if (test != scale) {
-			if (0 == test) return 0;
-			scale = test;
-			goto restart;
-		}
-	}
+	if (0 < scale) {
+		if (0 < _scale && INTMAX_MAX - _scale < scale) return INTMAX_MAX - _scale;
+	} else if (0 > _scale && (INTMAX_MIN + 1) - _scale > scale) return (INTMAX_MIN + 1) - _scale;
 	return scale;
 }
 
 intmax_t sum::ideal_scal_bn() const {
 	if (is_scal_bn_identity() || is_one()) return 0;
+	const auto ret = this->_properties.ideal_scal_bn([this] { return _ideal_scal_bn(); });
+	if (0 == ret) return 0;
+	// net of the block exponent
+	if (0 < ret) {
+		if (0 > _scale && INTMAX_MAX + _scale < ret) return 0;
+	} else if (0 < _scale && (INTMAX_MIN + 1) + _scale > ret) return 0;
+	return ret - _scale;
+}
+
+// of the terms, ignoring the block exponent
+intmax_t sum::_ideal_scal_bn() const {
 	intmax_t ret = 0;
 	for (const auto& x : this->_x) {
 		const auto test = x->ideal_scal_bn();
@@ -259,7 +518,7 @@ intmax_t sum::ideal_scal_bn() const {
 	return ret;
 }
 
-const math::type* sum::domain() const
+const math::type* sum::_domain() const
 {
 	if (_x.empty()) return &math::get<_type<_type_spec::_R_SHARP_>>(); // omni-zero is unconstrained \todo should be integers
 	std::vector<decltype(domain())> accumulator;
@@ -278,12 +537,17 @@ const math::type* sum::domain() const
 	}
 	const size_t ub = accumulator.size();
 	if (0 == ub) return nullptr;
-	else if (1 == ub) return accumulator.front();
+	else if (1 == ub) return 0 > _scale ? accumulator.front()->inverse(_type_spec::Multiplication) : accumulator.front();	// 2^-k: _Z_ widens to _Q_
 	else throw std::logic_error("unhandled addition domain");
 }
 
 std::string sum::to_s() const {
 	if (this->_x.empty()) return "0";
+	if (0 != _scale) return "(" + _terms_to_s() + ")*2<sup>" + std::to_string(_scale) + "</sup>";
+	return _terms_to_s();
+}
+
+std::string sum::_terms_to_s() const {
 	const auto _size = this->_x.size();
 	if (1 == _size) return this->_x.front()->to_s();
 	std::string ret;
@@ -299,7 +563,7 @@ std::string sum::to_s() const {
 	return ret;
 }
 
-std::optional<bool> sum::_is_finite() const {
+std::optional<bool> sum::_terms_finite() const {
 	for (decltype(auto) x : this->_x) {
 		if (const auto test = x->is_finite_kripke()) {
 			if (!*test) return false;
@@ -308,8 +572,9 @@ std::optional<bool> sum::_is_finite() const {
 	return true;
 }
 
-void sum::_scal_bn(intmax_t scale) {
-	for (auto& x : this->_x) x->scal_bn(scale);
+void sum::_scal_bn(intmax_t scale) {	// O(1)
+	_scale += scale;
+	this->_properties.clear();	// hash, and domain when _scale changes sign
 }
 
 } // namespace zaimoni
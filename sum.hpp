@@ -4,6 +4,8 @@
 #include "n_ary.hpp"
 #include "arithmetic.hpp"
 #include <any>
+#include <chrono>
+#include <unordered_map>
 
 namespace zaimoni {
 
@@ -18,11 +20,22 @@ public:
 private:
 	enum { strict_max_heuristic = _n_ary_op::strict_max_core_heuristic };
 
-	static std::vector<rule_guard> eval_ok;
-	static std::vector<eval_rule_spec> eval_algebraic_rules;
-	static std::vector<eval_rule_spec> eval_inexact_rules;
+	// rule_guard results by term, then guard index.  Guard results may point to the term, so the key is the term's
+	// address; the structural hash detects in-place changes (and address reuse).
+	struct guard_memo {
+		size_t term_hash;
+		std::vector<std::optional<std::any> > result;
+	};
+	std::unordered_map<const fp_API*, guard_memo> _guard_cache;
+	// by guard index, the terms it accepted; kept across passes while every term keeps its address and hash
+	std::map<size_t, std::vector<std::pair<ptrdiff_t, std::any> > > _interpreted;
+	std::vector<std::pair<const fp_API*, size_t> > _interpreted_terms;
+	size_t _exact_seen = SIZE_MAX;	// _changes as of the last exact summation
+	intmax_t _scale = 0;	// block exponent: the value is 2^_scale times the sum of the terms
 
 public:
+	static constexpr size_t exact_threshold = 3;	// floating-point leaves of one type, summed exactly in one pass
+
 	sum() = default;
 	sum(const sum& src) = default;
 	sum(sum&& src) = default;
@@ -30,14 +43,43 @@ public:
 	sum& operator=(const sum& src) = default;
 	sum& operator=(sum&& src) = default;
 
-	static void eval_algebraic_rule(const eval_rule_spec& src);
-	static void eval_inexact_rule(const eval_rule_spec& src);
+	// name is for profiling reports; it must outlive the registration.  Thread-safe; once the registry is frozen,
+	// registering a new rule throws std::logic_error.
+	static void eval_algebraic_rule(const eval_rule_spec& src, const char* name = nullptr);
+	static void eval_inexact_rule(const eval_rule_spec& src, const char* name = nullptr);
+	static void freeze_rules();	// after registering the built-in rules
+	static bool rules_frozen();
+
+	struct rule_table;
+	static const rule_table& rules();	// the current rules; never invalidated
+
+	// rule profiling, summed over all threads; rules are listed in registration order
+	struct rule_stats {
+		const char* name;
+		size_t guard_calls;	// both guards; memoized results are not counted
+		size_t guard_hits;
+		size_t tests;	// would_eval calls
+		size_t matches;
+		size_t fires;	// rule_eval returned a replacement
+		std::chrono::nanoseconds eval_time;	// cumulative, in rule_eval
+	};
+	static std::vector<rule_stats> algebraic_rule_stats();
+	static std::vector<rule_stats> inexact_rule_stats();
+	static void reset_rule_stats();
+	static void report_rules();
+	static void report_rules_at_exit();	// idempotent
+
 	static bool is_identity(const fp_API* x) { return x->is_zero(); }
 	static bool is_identity(const smart_ptr& x) { return x->is_zero(); }
 
 private:
 	bool _append_infinity(const smart_ptr& src);
+	const std::any& _guard(const rule_table& rules, size_t rule_index, size_t term_hash, const smart_ptr& x);
+	bool _exact_self_eval();
+	bool _self_eval_step();
+	bool _algebraic_self_eval_step();
 	void _append(smart_ptr&& src);
+	static void _scale_term(smart_ptr& x, intmax_t scale);
 
 public:
 	void append_term(const smart_ptr& src);
@@ -50,11 +92,12 @@ private:
 public:
 	// eval_to_ptr<fp_API>
 	eval_type destructive_eval() override;
-	bool algebraic_self_eval() override;
+	bool algebraic_self_eval() override { return _rewrite([this] { return _algebraic_self_eval_step(); }); }
 	bool inexact_self_eval() override { return self_eval(); } // stub
 
 	// fp_API
-	bool self_eval() override;
+	bool self_eval() override { return _rewrite([this] { return _self_eval_step(); }); }
+	std::optional<bool> local_self_eval() override { return _local_rewrite([this] { return _self_eval_step(); }); }
 	bool is_zero() const override;
 	bool is_one() const override;
 	int sgn() const override;
@@ -62,17 +105,32 @@ public:
 	bool is_scal_bn_identity() const override { return is_zero(); };	// let evaluation handle this, mostly
 	intmax_t scal_bn_is_safe(intmax_t scale) const override;
 	intmax_t ideal_scal_bn() const override;
-	const math::type* domain() const override;
+	intmax_t block_exponent() const { return _scale; }	// terms are in units of 2^block_exponent()
+	const math::type* domain() const override { return this->_properties.domain([this] { return _domain(); }); }
 	fp_API* clone() const override { return new sum(*this); }
 	sum* typed_clone() const { return new sum(*this); }
 	std::string to_s() const override;
 	int precedence() const override { return _precedence; }
+	size_t arity() const override { return this->_x.size(); }
+	const smart_ptr* term_c(size_t n) const override { return (this->_x.size() > n) ? &this->_x[n] : nullptr; }
+	smart_ptr* term(size_t n) override {
+		this->_changed();
+		return (this->_x.size() > n) ? &this->_x[n] : nullptr;
+	}
+	size_t node_hash() const override { return std::hash<intmax_t>()(_scale); }
+	bool node_equal(const fp_API& rhs) const override { return _scale == static_cast<const sum&>(rhs)._scale; }
+	size_t structural_hash() const override { return this->_properties.structural_hash([this] { return _structural_hash(); }); }
 
 private:
 	static constexpr const auto _precedence = _type_spec::Addition;
-	void _scal_bn(intmax_t scale) override;
+	intmax_t _ideal_scal_bn() const;
+	std::optional<int> _sgn() const;
+	const math::type* _domain() const;
+	std::optional<bool> _terms_finite() const;
+	std::string _terms_to_s() const;
+	void _scal_bn(intmax_t scale) override;	// changes no cached property but the structural hash
 	fp_API* _eval() const override { return nullptr; }	// placeholder
-	std::optional<bool> _is_finite() const override;
+	std::optional<bool> _is_finite() const override { return this->_properties.is_finite([this] { return _terms_finite(); }); }
 };
 
 } // namespace zaimoni
@@ -0,0 +1,159 @@
+// superaccumulator.hpp
+
+#ifndef SUPERACCUMULATOR_HPP
+#define SUPERACCUMULATOR_HPP 1
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace zaimoni {
+namespace math {
+
+// Exact sum of finite floating-point values (Kulisch accumulator).  The accumulator is a fixed-point integer wide enough
+// for every bit position of F, with carry headroom; each value is added in O(1), and the total is only rounded on request.
+// Bits are kept in 32-bit digits of signed 64-bit words, so carries are deferred until a word could overflow.
+template<std::floating_point F> requires(std::numeric_limits<F>::digits <= 64)
+class superaccumulator
+{
+	static constexpr int digits = std::numeric_limits<F>::digits;
+	static constexpr int min_bit = std::numeric_limits<F>::min_exponent - digits;	// denorm_min is 2^min_bit
+	static constexpr int bits = std::numeric_limits<F>::max_exponent - min_bit + 64;	// 64 bits of carry headroom
+	static constexpr size_t words = bits / 32 + 3;
+	static constexpr size_t max_pending = size_t(1) << 29;	// each add moves a word by less than 2^33
+	static constexpr int64_t low_mask = 0xFFFFFFFF;
+
+	std::vector<int64_t> _x;
+	size_t _pending;
+
+public:
+	superaccumulator() : _x(words, 0), _pending(0) {}
+	superaccumulator(const superaccumulator& src) = default;
+	superaccumulator(superaccumulator&& src) = default;
+	~superaccumulator() = default;
+	superaccumulator& operator=(const superaccumulator& src) = default;
+	superaccumulator& operator=(superaccumulator&& src) = default;
+
+	void clear() {
+		std::fill(_x.begin(), _x.end(), 0);
+		_pending = 0;
+	}
+
+	// finite values only
+	void push_back(F src) {
+		if (0 == src) return;
+		int e;
+		const F m = std::frexp(src, &e);
+		uint64_t mantissa = static_cast<uint64_t>(std::ldexp(std::fabs(m), digits));
+		int at = e - digits - min_bit;
+		if (0 > at) {	// denormal: the bits shifted out are zero
+			mantissa >>= -at;
+			at = 0;
+		}
+		const int64_t sign = std::signbit(src) ? -1 : 1;
+		const size_t i = at / 32;
+		const uint64_t lo = (mantissa & low_mask) << (at % 32);
+		const uint64_t hi = (mantissa >> 32) << (at % 32);
+		_x[i] += sign * int64_t(lo & low_mask);
+		_x[i + 1] += sign * int64_t((lo >> 32) + (hi & low_mask));
+		_x[i + 2] += sign * int64_t(hi >> 32);
+		if (max_pending <= ++_pending) _normalize(_x);
+	}
+
+	int sgn() const {
+		auto stage(_x);
+		_normalize(stage);
+		for (size_t i = words; 0 < i--; ) {
+			if (stage[i]) return 0 < stage[i] ? 1 : -1;
+		}
+		return 0;
+	}
+
+	// the exact total as non-overlapping values, largest magnitude first, each the nearest F to what remains; empty for
+	// zero.  std::nullopt on overflow.
+	std::optional<std::vector<F> > expansion() const {
+		superaccumulator stage(*this);
+		std::vector<F> ret;
+		while (true) {
+			auto remainder(stage._x);
+			const bool negative = _magnitude(remainder);
+			int at;
+			uint64_t mantissa = _take_leading(remainder, at);
+			if (!mantissa) return ret;
+			if (0 < at && (remainder[(at - 1) / 32] & (int64_t(1) << ((at - 1) % 32)))) {	// round to nearest
+				if (0 == ++mantissa || digits < int(std::bit_width(mantissa))) {
+					mantissa = uint64_t(1) << (digits - 1);
+					++at;
+				}
+			}
+			if (std::numeric_limits<F>::max_exponent < at + min_bit + int(std::bit_width(mantissa))) return std::nullopt;
+			const F term = std::ldexp(static_cast<F>(mantissa), at + min_bit);
+			ret.push_back(negative ? -term : term);
+			stage.push_back(-ret.back());
+		}
+	}
+
+	// tightest enclosing (lower, upper); an exact total has lower == upper
+	std::pair<F, F> bounds() const {
+		auto stage(_x);
+		const bool negative = _magnitude(stage);
+		int at;
+		const uint64_t mantissa = _take_leading(stage, at);
+		if (!mantissa) return std::pair<F, F>(0, 0);
+		F lb = std::numeric_limits<F>::max_exponent < at + min_bit + int(std::bit_width(mantissa)) ? std::numeric_limits<F>::max() : std::ldexp(static_cast<F>(mantissa), at + min_bit);
+		F ub = lb;
+		if (std::numeric_limits<F>::max() == lb || _take_leading(stage, at)) ub = std::nextafter(lb, std::numeric_limits<F>::infinity());
+		if (negative) return std::pair<F, F>(-ub, -lb);
+		return std::pair<F, F>(lb, ub);
+	}
+
+private:
+	// carry into the next word, so that all words but the top are in [0, 2^32)
+	static void _normalize(std::vector<int64_t>& x) {
+		for (size_t i = 0; i < words - 1; ++i) {
+			const int64_t carry = x[i] >> 32;
+			x[i] -= carry * (int64_t(1) << 32);
+			x[i + 1] += carry;
+		}
+	}
+
+	// converts x to sign-magnitude; returns true for negative
+	static bool _magnitude(std::vector<int64_t>& x) {
+		_normalize(x);
+		if (0 <= x[words - 1]) return false;
+		for (decltype(auto) w : x) w = -w;
+		_normalize(x);
+		return true;
+	}
+
+	// removes the leading (at most digits) bits of a normalized magnitude; at is the bit position of the result's lowest bit
+	static uint64_t _take_leading(std::vector<int64_t>& x, int& at) {
+		size_t i = words;
+		while (0 < i && 0 == x[i - 1]) --i;
+		if (0 == i) return 0;
+		const int top = 32 * int(i - 1) + int(std::bit_width(uint64_t(x[i - 1]))) - 1;
+		at = top - digits + 1;
+		if (0 > at) at = 0;
+		uint64_t ret = 0;
+		for (int b = top; b >= at; --b) {
+			int64_t& w = x[b / 32];
+			const int64_t bit = int64_t(1) << (b % 32);
+			ret <<= 1;
+			if (w & bit) {
+				ret |= 1;
+				w -= bit;
+			}
+		}
+		return ret;
+	}
+};
+
+}	// namespace math
+}	// namespace zaimoni
+
+#endif
@@ -3,6 +3,7 @@
 #include "arithmetic.hpp"
 #include "sum.hpp"
 #include "quotient.hpp"
+#include <mutex>
 
 namespace zaimoni {
 
@@ -54,11 +55,10 @@ fp_API* symbolic_fp::eval_multinv_sum(const typename eval_to_ptr<fp_API>::eval_t
 
 void symbolic_fp::global_init()
 {
-	static bool have_not_run = true;
-	if (have_not_run) {
-		sum::eval_algebraic_rule(std::pair(std::pair(multinv_sum_ok, multinv_sum_ok), std::pair(would_eval_multinv_sum, eval_multinv_sum)));
-		have_not_run = false;
-	}
+	static std::once_flag registered;
+	std::call_once(registered, [] {
+		sum::eval_algebraic_rule(std::pair(std::pair(multinv_sum_ok, multinv_sum_ok), std::pair(would_eval_multinv_sum, eval_multinv_sum)), "multinv_sum");
+	});
 }
 
 symbolic_fp::symbolic_fp(const decltype(dest)& src) noexcept : dest(src), scale_by(0), bitmap(0) {
@@ -67,7 +67,7 @@ symbolic_fp::symbolic_fp(const decltype(dest)& src) noexcept : dest(src), scale_
 }
 
 symbolic_fp::symbolic_fp(decltype(dest) && src) noexcept : dest(std::move(src)), scale_by(0), bitmap(0) {
-	assert(src);
+	assert(dest);
 	global_init();
 }
 
@@ -77,7 +77,7 @@ symbolic_fp::symbolic_fp(const decltype(dest)& src, intmax_t scale_by) noexcept
 }
 
 symbolic_fp::symbolic_fp(decltype(dest) && src, intmax_t scale_by) noexcept : dest(std::move(src)), scale_by(scale_by), bitmap(0) {
-	assert(src);
+	assert(dest);
 	global_init();
 }
 
@@ -351,6 +351,12 @@ std::optional<bool> symbolic_fp::_is_finite() const {
 	return dest->is_finite_kripke();
 }
 
+bool symbolic_fp::node_equal(const fp_API& rhs) const
+{
+	const auto& r = static_cast<const symbolic_fp&>(rhs);
+	return scale_by == r.scale_by && bitmap == r.bitmap;
+}
+
 std::partial_ordering symbolic_fp::_value_compare(const fp_API* rhs) const
 {
 	if (const auto mine = dynamic_cast<const symbolic_fp*>(rhs)) {
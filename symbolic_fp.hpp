@@ -5,6 +5,7 @@
 #include "Zaimoni.STL/Logging.h"
 #include <optional>
 #include <any>
+#include <functional>
 
 namespace zaimoni {
 
@@ -24,6 +25,8 @@ namespace zaimoni {
 			inverse_mult,
 		};
 
+		static void global_init();	// registers our sum rules; idempotent, and run by every constructor
+
 		explicit symbolic_fp(const decltype(dest)& src) noexcept;
 		symbolic_fp(decltype(dest) && src) noexcept;
 		// this doesn't trigger self-evaluation, unlike the scal_bn call
@@ -38,6 +41,7 @@ namespace zaimoni {
 
 		bool add_inverted() const { return bitmap & (1ULL << (int)op::inverse_add); }
 		bool mult_inverted() const { return bitmap & (1ULL << (int)op::inverse_mult); }
+		intmax_t scale_exponent() const { return scale_by; }	// value is scaled by 2^scale_exponent()
 
 		void self_multinv();
 		bool self_square();
@@ -74,6 +78,11 @@ namespace zaimoni {
 		fp_API* clone() const override;
 		std::string to_s() const override;
 		int precedence() const override;
+		size_t arity() const override { return 1; }
+		const eval_type* term_c(size_t n) const override { return (0 == n) ? &dest : nullptr; }
+		eval_type* term(size_t n) override { return (0 == n) ? &dest : nullptr; }
+		size_t node_hash() const override { return hash_combine(std::hash<intmax_t>()(scale_by), std::hash<uintmax_t>()(bitmap)); }
+		bool node_equal(const fp_API& rhs) const override;
 
 	private:
 		int would_rearrange_sum(const typename eval_to_ptr<fp_API>::eval_type& rhs) const;
@@ -81,7 +90,6 @@ namespace zaimoni {
 		static std::any multinv_sum_ok(const typename eval_to_ptr<fp_API>::eval_type& x);
 		static bool would_eval_multinv_sum(const std::any& lhs, const std::any& rhs);
 		static fp_API* eval_multinv_sum(const typename eval_to_ptr<fp_API>::eval_type& lhs, const typename eval_to_ptr<fp_API>::eval_type& rhs);
-		static void global_init();
 
 		void _scal_bn(intmax_t scale) override;
 		fp_API* _eval() const override;
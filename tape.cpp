@@ -0,0 +1,392 @@
+#include "tape.hpp"
+#include "sum.hpp"
+#include "product.hpp"
+#include "quotient.hpp"
+#include "power_fp.hpp"
+#include "symbolic_fp.hpp"
+#include "Zaimoni.STL/var.hpp"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace zaimoni {
+
+// outward rounding to double
+template<class T>
+static fp_tape::value_type _widen(const T& lb, const T& ub)
+{
+	double l = static_cast<double>(lb);
+	double u = static_cast<double>(ub);
+	if constexpr (!std::is_same_v<T, double> && !std::is_same_v<T, float>) {
+		if (static_cast<long double>(l) > static_cast<long double>(lb)) l = std::nextafter(l, -std::numeric_limits<double>::infinity());
+		if (static_cast<long double>(u) < static_cast<long double>(ub)) u = std::nextafter(u, std::numeric_limits<double>::infinity());
+	}
+	return fp_tape::value_type(l, u);
+}
+
+template<class T>
+static fp_tape::value_type _widen(const fp_API& src)
+{
+	const auto& x = static_cast<const var_fp<T>&>(src)._x;
+	if constexpr (requires { x.lower(); x.upper(); }) return _widen(x.lower(), x.upper());
+	else return _widen(x, x);
+}
+
+fp_tape::value_type fp_tape::to_interval(const fp_API& src)
+{
+	switch (src.leaf_tag()) {
+	case fp_leaf::f: return _widen<float>(src);
+	case fp_leaf::d: return _widen<double>(src);
+	case fp_leaf::ld: return _widen<long double>(src);
+	case fp_leaf::s_int: return _widen<intmax_t>(src);
+	case fp_leaf::u_int: return _widen<uintmax_t>(src);
+	case fp_leaf::interval_f: return _widen<ISK_INTERVAL<float> >(src);
+	case fp_leaf::interval_d: return _widen<ISK_INTERVAL<double> >(src);
+	case fp_leaf::interval_ld: return _widen<ISK_INTERVAL<long double> >(src);
+	default: throw std::logic_error("fp_tape: not a numeral: " + src.to_s());
+	}
+}
+
+static int _int_param(intmax_t src)
+{
+	if (std::numeric_limits<int>::max() < src || std::numeric_limits<int>::min() > src) throw std::logic_error("fp_tape: parameter out of range");
+	return (int)src;
+}
+
+namespace {
+
+struct tape_compiler
+{
+	std::vector<fp_tape::value_type>& registers;
+	std::vector<fp_tape::instruction>& code;
+	std::unordered_map<const fp_API*, unsigned int> seen;
+
+	unsigned int constant(const fp_tape::value_type& src) {
+		registers.push_back(src);
+		return registers.size() - 1;
+	}
+
+	unsigned int emit(fp_tape::opcode op, unsigned int lhs, unsigned int rhs = 0, int param = 0) {
+		const unsigned int dest = registers.size();
+		registers.push_back(fp_tape::value_type(0));
+		code.push_back(fp_tape::instruction{ op, param, dest, lhs, rhs });
+		return dest;
+	}
+
+	unsigned int n_ary(const fp_API& src, fp_tape::opcode op, double identity) {
+		const size_t ub = src.arity();
+		if (0 == ub) return constant(fp_tape::value_type(identity));
+		auto ret = lower(*src.term_c(0)->get_c());
+		for (size_t i = 1; i < ub; ++i) {
+			const auto rhs = lower(*src.term_c(i)->get_c());
+			if (1 == i) ret = emit(op, ret, rhs);
+			else code.push_back(fp_tape::instruction{ op, 0, ret, ret, rhs });	// accumulate in our own temporary
+		}
+		return ret;
+	}
+
+	unsigned int lower(const fp_API& src) {
+		if (const auto x = seen.find(&src); seen.end() != x) return x->second;
+		const auto ret = _lower(src);
+		seen[&src] = ret;
+		return ret;
+	}
+
+private:
+	unsigned int _lower(const fp_API& src) {
+		if (fp_leaf::none != src.leaf_tag()) return constant(fp_tape::to_interval(src));
+		if (const auto x = dynamic_cast<const sum*>(&src)) {
+			const auto ret = n_ary(src, fp_tape::opcode::add, 0.0);
+			if (const auto scale = x->block_exponent()) return emit(fp_tape::opcode::scal_bn, ret, 0, _int_param(scale));
+			return ret;
+		}
+		if (dynamic_cast<const product*>(&src)) return n_ary(src, fp_tape::opcode::mul, 1.0);
+		if (dynamic_cast<const quotient*>(&src)) {
+			const auto n = lower(*src.term_c(0)->get_c());
+			return emit(fp_tape::opcode::div, n, lower(*src.term_c(1)->get_c()));
+		}
+		if (dynamic_cast<const power_fp*>(&src)) {
+			const auto& exponent = *src.term_c(1)->get_c();
+			if (fp_leaf::none == exponent.leaf_tag()) throw std::logic_error("fp_tape: non-numeral exponent: " + src.to_s());
+			const auto e = fp_tape::to_interval(exponent);
+			if (e.lower() != e.upper() || std::trunc(e.lower()) != e.lower()) throw std::logic_error("fp_tape: non-integer exponent: " + src.to_s());
+			if (std::numeric_limits<int>::max() < e.lower() || std::numeric_limits<int>::min() > e.lower()) throw std::logic_error("fp_tape: exponent out of range");
+			return emit(fp_tape::opcode::pow, lower(*src.term_c(0)->get_c()), 0, (int)e.lower());
+		}
+		if (const auto x = dynamic_cast<const symbolic_fp*>(&src)) {
+			auto ret = lower(*src.term_c(0)->get_c());
+			if (x->mult_inverted()) ret = emit(fp_tape::opcode::inv, ret);
+			if (x->add_inverted()) ret = emit(fp_tape::opcode::neg, ret);
+			if (const auto scale = x->scale_exponent()) ret = emit(fp_tape::opcode::scal_bn, ret, 0, _int_param(scale));
+			return ret;
+		}
+		throw std::logic_error("fp_tape: no interval lowering for " + src.to_s());
+	}
+};
+
+}
+
+fp_tape::fp_tape(const fp_API& src, const std::vector<const fp_API*>& inputs)
+{
+	tape_compiler compile{ _registers, _code, {} };
+	for (const auto x : inputs) {
+		if (const auto test = compile.seen.find(x); compile.seen.end() != test) {
+			_inputs.push_back(test->second);
+			continue;
+		}
+		const auto dest = compile.constant(fp_leaf::none != x->leaf_tag() ? to_interval(*x) : value_type(0));
+		compile.seen[x] = dest;
+		_inputs.push_back(dest);
+	}
+	_result = compile.lower(src);
+}
+
+const fp_tape::value_type& fp_tape::eval()
+{
+	for (const auto& op : _code) {
+		auto& dest = _registers[op.dest];
+		switch (op.code) {
+		case opcode::add:
+			dest = _registers[op.lhs] + _registers[op.rhs];
+			break;
+		case opcode::mul:
+			dest = _registers[op.lhs] * _registers[op.rhs];
+			break;
+		case opcode::div:
+			dest = _registers[op.lhs] / _registers[op.rhs];
+			break;
+		case opcode::neg:
+			dest = -_registers[op.lhs];
+			break;
+		case opcode::inv:
+			dest = 1.0 / _registers[op.lhs];
+			break;
+		case opcode::scal_bn:
+			dest = scalBn(_registers[op.lhs], op.param);
+			break;
+		case opcode::pow:
+			dest = math::pow(_registers[op.lhs], op.param);
+			break;
+		}
+	}
+	return _registers[_result];
+}
+
+std::pair<fp_tape::value_type, fp_tape::value_type> fp_tape::eval_tangent(size_t n)
+{
+	_tangents.assign(_registers.size(), value_type(0));
+	_tangents[_inputs[n]] = value_type(1);
+	for (const auto& op : _code) {
+		const auto& a = _registers[op.lhs];
+		const auto& b = _registers[op.rhs];
+		const auto& da = _tangents[op.lhs];
+		const auto& db = _tangents[op.rhs];
+		value_type x;	// staged: instructions may accumulate into an operand
+		value_type dx;
+		switch (op.code) {
+		case opcode::add:
+			x = a + b;
+			dx = da + db;
+			break;
+		case opcode::mul:
+			x = a * b;
+			dx = da * b + a * db;
+			break;
+		case opcode::div:
+			x = a / b;
+			dx = (da - x * db) / b;
+			break;
+		case opcode::neg:
+			x = -a;
+			dx = -da;
+			break;
+		case opcode::inv:
+			x = 1.0 / a;
+			dx = -(da * math::square(x));
+			break;
+		case opcode::scal_bn:
+			x = scalBn(a, op.param);
+			dx = scalBn(da, op.param);
+			break;
+		case opcode::pow:
+			x = math::pow(a, op.param);
+			dx = (0 == op.param) ? value_type(0) : value_type(op.param) * math::pow(a, op.param - 1) * da;
+			break;
+		}
+		_registers[op.dest] = x;
+		_tangents[op.dest] = dx;
+	}
+	return std::pair(_registers[_result], _tangents[_result]);
+}
+
+std::optional<fp_tape::value_type> fp_tape::newton(size_t n, value_type x, double width, size_t max_iterations)
+{
+	while (0 < max_iterations--) {
+		bind(n, x);
+		const auto [f_x, slope] = eval_tangent(n);
+		if (!f_x.contains(0.0)) return std::nullopt;
+		if (slope.contains(0.0)) break;
+		const auto mid = x.median();
+		bind(n, mid);
+		const auto f_mid = eval();
+		auto next = mid - f_mid / slope;
+		if (next.upper() < x.lower() || x.upper() < next.lower()) return std::nullopt;
+		next.self_intersect(x);
+		if (next.lower() == x.lower() && next.upper() == x.upper()) break;	// converged, as far as double goes
+		x = next;
+		if (x.width() <= width) break;
+	}
+	bind(n, x);
+	return x;
+}
+
+fp_tape_batch::fp_tape_batch(const fp_tape& src, size_t n)
+: _code(src._code), _constants(src._registers), _inputs(src._inputs), _result(src._result), _n(0)
+{
+	resize(n);
+}
+
+void fp_tape_batch::resize(size_t n)
+{
+	_n = n;
+	_lb.resize(_constants.size() * n);
+	_ub.resize(_constants.size() * n);
+	_scratch.resize(2 * n);
+	for (size_t r = 0; r < _constants.size(); ++r) {
+		std::fill_n(_lb.data() + r * n, n, _constants[r].lower());
+		std::fill_n(_ub.data() + r * n, n, _constants[r].upper());
+	}
+}
+
+template<class LB, class UB, class Slow, class Scalar>
+void fp_tape_batch::_apply(const fp_tape::instruction& op, bool unary, LB lb, UB ub, Slow slow, Scalar scalar)
+{
+	const double* const a_lb = _lb.data() + op.lhs * _n;
+	const double* const a_ub = _ub.data() + op.lhs * _n;
+	const double* const b_lb = unary ? a_lb : _lb.data() + op.rhs * _n;
+	const double* const b_ub = unary ? a_ub : _ub.data() + op.rhs * _n;
+	double* const t_lb = _scratch.data();
+	double* const t_ub = t_lb + _n;
+
+	// keep these loops free of branches and calls, so they vectorize
+	math::bits::round_set<double>(FE_DOWNWARD);
+	for (size_t i = 0; i < _n; ++i) t_lb[i] = lb(a_lb[i], a_ub[i], b_lb[i], b_ub[i]);
+	math::bits::round_set<double>(FE_UPWARD);
+	for (size_t i = 0; i < _n; ++i) t_ub[i] = ub(a_lb[i], a_ub[i], b_lb[i], b_ub[i]);
+
+	for (size_t i = 0; i < _n; ++i) {
+		if (std::isfinite(t_lb[i]) && std::isfinite(t_ub[i]) && !slow(b_lb[i], b_ub[i])) continue;
+		const auto x = scalar(value_type(a_lb[i], a_ub[i]), value_type(b_lb[i], b_ub[i]));
+		t_lb[i] = x.lower();
+		t_ub[i] = x.upper();
+	}
+
+	std::copy_n(t_lb, _n, _lb.data() + op.dest * _n);
+	std::copy_n(t_ub, _n, _ub.data() + op.dest * _n);
+}
+
+template<class Scalar>
+void fp_tape_batch::_apply_scalar(const fp_tape::instruction& op, bool unary, Scalar scalar)
+{
+	const double* const a_lb = _lb.data() + op.lhs * _n;
+	const double* const a_ub = _ub.data() + op.lhs * _n;
+	const double* const b_lb = unary ? a_lb : _lb.data() + op.rhs * _n;
+	const double* const b_ub = unary ? a_ub : _ub.data() + op.rhs * _n;
+	double* const d_lb = _lb.data() + op.dest * _n;
+	double* const d_ub = _ub.data() + op.dest * _n;
+
+	for (size_t i = 0; i < _n; ++i) {	// lane by lane, so the destination may be an operand
+		const auto x = scalar(value_type(a_lb[i], a_ub[i]), value_type(b_lb[i], b_ub[i]));
+		d_lb[i] = x.lower();
+		d_ub[i] = x.upper();
+	}
+}
+
+static double _min4(double a, double b, double c, double d) { return std::min(std::min(a, b), std::min(c, d)); }
+static double _max4(double a, double b, double c, double d) { return std::max(std::max(a, b), std::max(c, d)); }
+
+// x * abs_x^(e - 1), by multiplying in turn.  Every partial product has x's sign, so each rounds the current rounding
+// mode's way: a bound on x^e that way.
+static double _pow_rounded(double x, double abs_x, int e)
+{
+	for (int k = 1; k < e; ++k) x *= abs_x;
+	return x;
+}
+
+void fp_tape_batch::eval()
+{
+	using V = value_type;
+	const int mode = math::bits::round_get<double>();
+	const auto never = [](double, double) { return false; };
+	const auto straddles_zero = [](double l, double u) { return l <= 0.0 && 0.0 <= u; };
+
+	for (const auto& op : _code) {
+		switch (op.code) {
+		case fp_tape::opcode::add:
+			_apply(op, false,
+				[](double al, double, double bl, double) { return al + bl; },
+				[](double, double au, double, double bu) { return au + bu; },
+				never, [](const V& a, const V& b) { return a + b; });
+			break;
+		case fp_tape::opcode::mul:
+			_apply(op, false,
+				[](double al, double au, double bl, double bu) { return _min4(al * bl, al * bu, au * bl, au * bu); },
+				[](double al, double au, double bl, double bu) { return _max4(al * bl, al * bu, au * bl, au * bu); },
+				never, [](const V& a, const V& b) { return a * b; });
+			break;
+		case fp_tape::opcode::div:
+			_apply(op, false,
+				[](double al, double au, double bl, double bu) { return _min4(al / bl, al / bu, au / bl, au / bu); },
+				[](double al, double au, double bl, double bu) { return _max4(al / bl, al / bu, au / bl, au / bu); },
+				straddles_zero, [](const V& a, const V& b) { return a / b; });
+			break;
+		case fp_tape::opcode::neg:
+			_apply(op, true,
+				[](double, double au, double, double) { return -au; },
+				[](double al, double, double, double) { return -al; },
+				never, [](const V& a, const V&) { return -a; });
+			break;
+		case fp_tape::opcode::inv:
+			_apply(op, true,
+				[](double, double au, double, double) { return 1.0 / au; },
+				[](double al, double, double, double) { return 1.0 / al; },
+				straddles_zero, [](const V& a, const V&) { return 1.0 / a; });
+			break;
+		case fp_tape::opcode::scal_bn: {
+			const int e = op.param;
+			_apply(op, true,
+				[e](double al, double, double, double) { return std::ldexp(al, e); },
+				[e](double, double au, double, double) { return std::ldexp(au, e); },
+				never, [e](const V& a, const V&) { return scalBn(a, e); });
+			}
+			break;
+		case fp_tape::opcode::pow:
+			if (2 == op.param) {
+				_apply(op, true,
+					[](double al, double au, double, double) { const double x = 0.0 < al ? al : (0.0 > au ? -au : 0.0); return x * x; },
+					[](double al, double au, double, double) { const double x = std::max(-al, au); return x * x; },
+					never, [](const V& a, const V&) { return math::square(a); });
+			} else if (2 < op.param && 8 >= op.param) {
+				const int e = op.param;
+				if (e % 2) {	// increasing
+					_apply(op, true,
+						[e](double al, double, double, double) { return _pow_rounded(al, al < 0.0 ? -al : al, e); },
+						[e](double, double au, double, double) { return _pow_rounded(au, au < 0.0 ? -au : au, e); },
+						never, [e](const V& a, const V&) { return math::pow(a, e); });
+				} else {
+					_apply(op, true,
+						[e](double al, double au, double, double) { const double x = 0.0 < al ? al : (0.0 > au ? -au : 0.0); return _pow_rounded(x, x, e); },
+						[e](double al, double au, double, double) { const double x = std::max(-al, au); return _pow_rounded(x, x, e); },
+						never, [e](const V& a, const V&) { return math::pow(a, e); });
+				}
+			} else {	// negative or larger exponents: math::pow squares, lane by lane
+				const int e = op.param;
+				_apply_scalar(op, true, [e](const V& a, const V&) { return math::pow(a, e); });
+			}
+			break;
+		}
+	}
+	math::bits::round_set<double>(mode);
+}
+
+}	// namespace zaimoni
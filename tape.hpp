@@ -0,0 +1,136 @@
+#ifndef TAPE_HPP
+#define TAPE_HPP 1
+
+#include "Zaimoni.STL/eval.hpp"
+#include "Zaimoni.STL/interval.hpp"
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace zaimoni {
+
+// An fp_API expression lowered to a linear tape of interval operations.  Compile once, after simplification;
+// rebinding inputs and re-evaluating does not allocate.
+class fp_tape final
+{
+public:
+	using value_type = ISK_INTERVAL<double>;
+
+	enum class opcode : unsigned char {
+		add = 0,
+		mul,
+		div,
+		neg,
+		inv,
+		scal_bn,	// param is the power of 2
+		pow	// param is the integer exponent
+	};
+
+	struct instruction {
+		opcode code;
+		int param;
+		unsigned int dest;
+		unsigned int lhs;
+		unsigned int rhs;
+	};
+
+private:
+	std::vector<value_type> _registers;	// one per distinct node
+	std::vector<instruction> _code;
+	std::vector<unsigned int> _inputs;	// register of each input, in binding order
+	unsigned int _result;
+	std::vector<value_type> _tangents;	// eval_tangent: d(register)/d(input), one per register
+
+public:
+	// nodes listed in inputs (by address; typically leaves) are bound at evaluation time.  Shared subtrees are computed once.
+	// throws std::logic_error for node types that have no interval lowering
+	fp_tape(const fp_API& src, const std::vector<const fp_API*>& inputs = {});
+	fp_tape(const fp_tape& src) = default;
+	fp_tape(fp_tape&& src) = default;
+	~fp_tape() = default;
+	fp_tape& operator=(const fp_tape& src) = default;
+	fp_tape& operator=(fp_tape&& src) = default;
+
+	size_t size() const { return _code.size(); }
+	size_t inputs() const { return _inputs.size(); }
+	const std::vector<instruction>& code() const { return _code; }
+
+	void bind(size_t n, const value_type& src) { _registers[_inputs[n]] = src; }
+	const value_type& eval();
+	// value and derivative with respect to input n: forward mode, carrying a tangent interval alongside each register
+	std::pair<value_type, value_type> eval_tangent(size_t n);
+	// interval Newton for a zero in x, as a function of input n (the other inputs as bound).  Every zero in x is in the
+	// result; std::nullopt if there are none.  Stops at width, or when the derivative over x straddles zero (no
+	// contraction without splitting x).  Leaves input n bound to the result.
+	std::optional<value_type> newton(size_t n, value_type x, double width = 0.0, size_t max_iterations = 64);
+	const value_type& operator()(std::span<const value_type> args) {
+		const size_t ub = args.size() < _inputs.size() ? args.size() : _inputs.size();
+		for (size_t i = 0; i < ub; ++i) bind(i, args[i]);
+		return eval();
+	}
+
+	static value_type to_interval(const fp_API& src);	// numeral leaves only; throws std::logic_error otherwise
+
+	friend class fp_tape_batch;
+};
+
+// A compiled tape evaluated over many input tuples at once.  Registers are stored structure-of-arrays: for each register,
+// a contiguous column of lower bounds and one of upper bounds, so each instruction is a pair of branch-free loops
+// (one per rounding mode) across the whole batch.  Lanes the fast path cannot handle (non-finite results, division by
+// an interval containing zero) are redone with the scalar interval operators, which keep their error semantics.
+class fp_tape_batch final
+{
+public:
+	using value_type = fp_tape::value_type;
+
+private:
+	std::vector<fp_tape::instruction> _code;
+	std::vector<value_type> _constants;	// initial register values, from the tape
+	std::vector<unsigned int> _inputs;
+	unsigned int _result;
+	size_t _n;	// lanes
+	std::vector<double> _lb;	// register r, lane i is at [r*_n+i]
+	std::vector<double> _ub;
+	std::vector<double> _scratch;	// 2*_n: results are staged here, as instructions may accumulate into an operand
+
+public:
+	fp_tape_batch(const fp_tape& src, size_t n);
+	fp_tape_batch(const fp_tape_batch& src) = default;
+	fp_tape_batch(fp_tape_batch&& src) = default;
+	~fp_tape_batch() = default;
+	fp_tape_batch& operator=(const fp_tape_batch& src) = default;
+	fp_tape_batch& operator=(fp_tape_batch&& src) = default;
+
+	size_t size() const { return _n; }
+	size_t inputs() const { return _inputs.size(); }
+	void resize(size_t n);	// resets all lanes to the tape's initial values
+
+	// input columns may be filled directly
+	double* lower(size_t n) { return _lb.data() + _inputs[n] * _n; }
+	double* upper(size_t n) { return _ub.data() + _inputs[n] * _n; }
+	void bind(size_t n, size_t lane, const value_type& src) {
+		lower(n)[lane] = src.lower();
+		upper(n)[lane] = src.upper();
+	}
+	void bind(size_t n, std::span<const value_type> src) {
+		const size_t ub = src.size() < _n ? src.size() : _n;
+		for (size_t i = 0; i < ub; ++i) bind(n, i, src[i]);
+	}
+
+	void eval();	// restores the floating-point rounding mode on return
+	const double* result_lower() const { return _lb.data() + _result * _n; }
+	const double* result_upper() const { return _ub.data() + _result * _n; }
+	value_type result(size_t lane) const { return value_type(result_lower()[lane], result_upper()[lane]); }
+
+private:
+	// unary instructions see their operand as both lhs and rhs
+	template<class LB, class UB, class Slow, class Scalar>
+	void _apply(const fp_tape::instruction& op, bool unary, LB lb, UB ub, Slow slow, Scalar scalar);
+	// no fast path: every lane goes through the scalar interval operator
+	template<class Scalar> void _apply_scalar(const fp_tape::instruction& op, bool unary, Scalar scalar);
+};
+
+}	// namespace zaimoni
+
+#endif